@@ -9,11 +9,30 @@
  */
 
 #include <cctype>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <string>
+#include <thread>
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#else
+#include <unistd.h>
+#endif
+#include "codecache.h"
 #include "exp.h"
+#include "image.h"
+#include "input.h"
+#include "mapfile.h"
+#include "output.h"
 #include "parser.h"
 #include "program.h"
+#include "server.h"
+#include "session.h"
+#include "stmtcache.h"
 #include "../StanfordCPPLib/error.h"
 #include "../StanfordCPPLib/tokenscanner.h"
 
@@ -23,73 +42,217 @@ using namespace std;
 
 /* Function prototypes */
 
-void processLine(string line, Program & program, EvalState & state);
+int runBatch(int argc, char **argv);
+int runServer(int argc, char **argv);
+void reportStats(EvalState & state, StatementCache *cache, CodeCache *code = nullptr);
+void flushOnCrash(int sig);
 
 /* Main program */
 
-int main() {
-   EvalState state;
-   Program program;
+int main(int argc, char **argv) {
+   if (argc > 1 && string(argv[1]) == "--serve") return runServer(argc, argv);
+   if (argc > 1) return runBatch(argc, argv);
+   Session session;
+   if (getenv("BASIC_COMPACT") != nullptr) session.getProgram().setCompact(true);
+   if (isatty(1)) standardOutput().setBuffered(false);
+   signal(SIGFPE, flushOnCrash);
    //cout << "Stub implementation of BASIC" << endl;
-   while (true) {
-      try {
-         processLine(getLine(), program, state);
-      } catch (ErrorException & ex) {
-           cout << ex.getMessage() << endl;
-      }
+   if (!session.run()) {
+      reportStats(session.getState(), &session.getCache());
+      exit(0);
    }
    return 0;
 }
 
 /*
- * Function: processLine
- * Usage: processLine(line, program, state);
- * -----------------------------------------
- * Processes a single line entered by the user. In this version,
- * the implementation does exactly what the interpreter program
- * does in Chapter 19: read a line, parse it as an expression,
- * and then print the result.  In your implementation, you will
- * need to replace this method with one that can respond correctly
- * when the user enters a program line (which begins with a number)
- * or one of the BASIC commands, such as LIST or RUN.
+ * Function: flushOnCrash
+ * Usage: signal(SIGFPE, flushOnCrash);
+ * ------------------------------------
+ * Dividing the smallest integer by -1 traps, as it always has.  This
+ * handler writes out what the program printed before the trap and then
+ * lets the signal take its usual course.  It writes with
+ * flushFromSignal, since flush may allocate, which is not safe in a
+ * signal handler.
  */
 
-void processLine(string line, Program & program, EvalState & state) {
-	if (line == "") return;
-	static const int SIZE = 5;
-	static string cmd[SIZE] = { "RUN","LIST","HELP","QUIT","CLEAR"};
-	TokenScanner scanner;
-	scanner.ignoreWhitespace();
-	scanner.scanNumbers();
-	scanner.setInput(line);
-	string fst = scanner.nextToken();
-	int c = 0;
-	while (c < SIZE && cmd[c] != fst) c++;
-	if (c < SIZE) {
-		if (scanner.hasMoreTokens()) error("SYNTAX ERROR");
-		switch (c) {
-			case 0: program.run(state); break;
-			case 1: program.display(); break;
-			case 2: cout << "Nobody can help you!" << endl; break;
-			case 3: exit(0);
-			case 4: program.clear(); state.clear();
+void flushOnCrash(int sig) {
+   standardOutput().flushFromSignal();
+   signal(sig, SIG_DFL);
+   raise(sig);
+}
+
+/*
+ * Function: runBatch
+ * Usage: return runBatch(argc, argv);
+ * -----------------------------------
+ * Runs the program in the file named on the command line, as in
+ *
+ *    code file.bas [--input file]
+ *
+ * without the command loop.  The file is mapped and loaded in one pass,
+ * or read as by LOAD if it is a program image, and the program is then
+ * run once, with INPUT reading from the --input file or else from the
+ * standard input.  A line that cannot be loaded is reported as it would
+ * be if it were typed, and the rest still runs.
+ *
+ * If BASIC_CACHE_DIR names a directory, programs that load without
+ * errors are kept there as images (see codecache.h), limited to
+ * BASIC_CACHE_SIZE bytes, so that the next run of the same program
+ * skips parsing it.  If BASIC_COMPACT is set, the source lines are
+ * kept in the tokenized form of compact.h.
+ * Returns the exit status, which is 1 if the program stops on an error.
+ */
+
+int runBatch(int argc, char **argv) {
+	string sourceName, inputName;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		string arg = argv[i];
+		if (arg == "--input" && i + 1 < argc && inputName == "") inputName = argv[++i];
+		else if (arg[0] != '-' && sourceName == "") sourceName = arg;
+		else usage = true;
+	}
+	if (usage || sourceName == "") {
+		cerr << "Usage: " << argv[0] << " [file.bas [--input file]]" << endl;
+		cerr << "       " << argv[0] << " --serve socket [--workers n] [--slice n] [--images dir]"
+		     << endl;
+		return 2;
+	}
+	int fd = 0;
+	if (inputName != "") {
+		fd = open(inputName.c_str(), O_RDONLY);
+		if (fd < 0) {
+			cerr << "Can't open " << inputName << endl;
+			return 1;
 		}
 	}
-	else if (scanner.getTokenType(fst) == NUMBER) {
-		if (scanner.hasMoreTokens())
-			program.addSourceLine(stringToInteger(fst), line);
-		else
-			program.removeSourceLine(stringToInteger(fst));
+	EvalState state;
+	Program program;
+	if (getenv("BASIC_COMPACT") != nullptr) program.setCompact(true);
+	OutputSink & out = standardOutput();
+	LineReader input(fd);
+	if (fd != 0) state.setInput(input);
+	if (isatty(1)) out.setBuffered(false);
+	signal(SIGFPE, flushOnCrash);
+	CodeCache *code = nullptr;
+	if (getenv("BASIC_CACHE_DIR") != nullptr) {
+		const char *limit = getenv("BASIC_CACHE_SIZE");
+		long long maxBytes = limit == nullptr ? 64 << 20 : atoll(limit);
+		code = new CodeCache(getenv("BASIC_CACHE_DIR"), maxBytes);
+	}
+	int status = 0;
+	try {
+		MappedFile source(sourceName);
+		if (isProgramImage(source.getData(), source.getSize())) {
+			program.load(sourceName);
+		} else if (code == nullptr || !code->load(program, source.getData(), source.getSize())) {
+			vector<string> errors;
+			program.loadSource(source.getData(), source.getSize(), errors);
+			for (size_t i = 0; i < errors.size(); i++) out.writeLine(errors[i]);
+			if (code != nullptr && errors.empty()) code->store(program, source.getData(), source.getSize());
+		}
+	} catch (ErrorException & ex) {
+		cerr << ex.getMessage() << endl;
+		status = 1;
+	}
+	if (status == 0) {
+		try {
+			program.run(state);
+		} catch (ErrorException & ex) {
+			out.writeLine(ex.getMessage());
+			status = 1;
+		}
+	}
+	out.flush();
+	reportStats(state, nullptr, code);
+	delete code;
+	if (fd != 0) close(fd);
+	return status;
+}
+
+/*
+ * Function: runServer
+ * Usage: return runServer(argc, argv);
+ * ------------------------------------
+ * Runs the interpreter as a server, as in
+ *
+ *    code --serve socket [--workers n] [--slice n] [--images dir]
+ *
+ * with one session for every client that connects to the socket (see
+ * server.h).  The number of workers defaults to the number of cores,
+ * and programs are preempted every DEFAULT_SLICE statements unless the
+ * slice is given; a slice of 0 turns preemption off.  Clients can only
+ * SAVE and LOAD images in the directory given with --images, and not at
+ * all without it.  The scheduler reports to cerr when BASIC_STATS is
+ * set.  Returns only if the server cannot start.
+ */
+
+static const int DEFAULT_SLICE = 10000;
+
+int runServer(int argc, char **argv) {
+	int workers = thread::hardware_concurrency();
+	if (workers < 1) workers = 1;
+	int slice = DEFAULT_SLICE;
+	string images;
+	bool usage = argc < 3 || argv[2][0] == '-';
+	for (int i = 3; i < argc && !usage; i += 2) {
+		string arg = argv[i];
+		if (i + 1 == argc) {
+			usage = true;
+		} else if (arg == "--workers") {
+			usage = !parseInteger(argv[i + 1], strlen(argv[i + 1]), workers) || workers < 1;
+		} else if (arg == "--slice") {
+			usage = !parseInteger(argv[i + 1], strlen(argv[i + 1]), slice) || slice < 0;
+		} else if (arg == "--images") {
+			images = argv[i + 1];
+			usage = images == "";
+		} else {
+			usage = true;
+		}
+	}
+	if (usage) {
+		cerr << "Usage: " << argv[0] << " --serve socket [--workers n] [--slice n] [--images dir]"
+		     << endl;
+		return 2;
+	}
+	ServerOptions options;
+	options.workers = workers;
+	options.slice = slice;
+	options.imageDirectory = images;
+	options.stats = getenv("BASIC_STATS") != nullptr ? &cerr : nullptr;
+	try {
+		serveSessions(argv[2], options);
+	} catch (ErrorException & ex) {
+		cerr << ex.getMessage() << endl;
+	}
+	return 1;
+}
+
+/*
+ * Function: reportStats
+ * Usage: reportStats(state, &cache);
+ *        reportStats(state, nullptr, code);
+ * ------------------------------------------
+ * Prints the hit rates of the interpreter's caches to cerr when the
+ * BASIC_STATS environment variable is set, so that they can be checked
+ * on a trace without changing its output.  cache is nullptr when no
+ * commands were read and code when no code cache was used.
+ */
+
+void reportStats(EvalState & state, StatementCache *cache, CodeCache *code) {
+	if (getenv("BASIC_STATS") == nullptr) return;
+	cerr << "inline cache: " << state.getCacheHits() << " hits, "
+	     << state.getCacheMisses() << " misses" << endl;
+	if (cache != nullptr) {
+		cerr << "statement cache: " << cache->getHits() << " hits, "
+		     << cache->getMisses() << " misses, "
+		     << cache->getEvictions() << " evictions" << endl;
 	}
-	else {
-		if(fst!="PRINT" && fst!="LET" && fst!="INPUT")
-			error("SYNTAX ERROR");
-		Statement *stmt = nullptr;
-		if (fst == "PRINT") stmt = new PRINT_Sta;
-		else if (fst == "LET") stmt = new LET_Sta;
-		else stmt = new INPUT_Sta;
-		stmt->parseSta(scanner);
-		stmt->execute(state);
-		delete stmt;
+	if (code != nullptr) {
+		cerr << "code cache: " << code->getHits() << " hits, "
+		     << code->getMisses() << " misses, "
+		     << code->getStores() << " stores, "
+		     << code->getEvictions() << " evictions" << endl;
 	}
+	cerr << "output: " << state.getOutput().getWriteCount() << " writes" << endl;
 }
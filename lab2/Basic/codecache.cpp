@@ -0,0 +1,199 @@
+/*
+ * File: codecache.cpp
+ * -------------------
+ * This file implements the codecache.h interface.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <utime.h>
+#endif
+#include "codecache.h"
+#include "image.h"
+#include "../StanfordCPPLib/error.h"
+using namespace std;
+
+/*
+ * Constant: BUILD_ID
+ * ------------------
+ * Identifies the build of the interpreter in the cache keys.  The
+ * makefile sets it with -DBASIC_BUILD_ID=... to a hash of all sources,
+ * so that images parsed by an older parser are never loaded.  Builds
+ * that do not set it fall back on the time this file was compiled,
+ * which is only safe if this file is compiled on every build.
+ */
+
+#ifndef BASIC_BUILD_ID
+#define BASIC_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+static const char BUILD_ID[] = BASIC_BUILD_ID;
+
+CodeCache::CodeCache(const string & directory, long long maxBytes) {
+   this->directory = directory;
+   this->maxBytes = maxBytes;
+   hits = misses = stores = evictions = 0;
+#ifdef _WIN32
+   _mkdir(directory.c_str());
+#else
+   mkdir(directory.c_str(), 0777);
+#endif
+}
+
+bool CodeCache::load(Program & program, const char *text, size_t length) {
+#ifdef _WIN32
+   misses++;
+   return false;
+#else
+   string path = directory + "/" + entryName(text, length);
+   struct stat info;
+   if (stat(path.c_str(), &info) != 0) {
+      misses++;
+      return false;
+   }
+   try {
+      program.load(path);
+   } catch (ErrorException &) {
+      remove(path.c_str());
+      misses++;
+      return false;
+   }
+   utime(path.c_str(), nullptr);
+   hits++;
+   return true;
+#endif
+}
+
+void CodeCache::store(Program & program, const char *text, size_t length) {
+#ifndef _WIN32
+   string path = directory + "/" + entryName(text, length);
+   try {
+      program.save(path);
+   } catch (ErrorException &) {
+      return;
+   }
+   stores++;
+   evict(path);
+#endif
+}
+
+long long CodeCache::getHits() {
+   return hits;
+}
+
+long long CodeCache::getMisses() {
+   return misses;
+}
+
+long long CodeCache::getStores() {
+   return stores;
+}
+
+long long CodeCache::getEvictions() {
+   return evictions;
+}
+
+/*
+ * Implementation notes: entryName
+ * -------------------------------
+ * The key is made of two 64-bit FNV-1a hashes with different offsets,
+ * each over the build id, the image version and every non-blank line
+ * followed by a newline.
+ */
+
+static void hashBytes(unsigned long long hash[2], const char *data, size_t length) {
+   for (size_t i = 0; i < length; i++) {
+      for (int k = 0; k < 2; k++) {
+         hash[k] ^= (unsigned char) data[i];
+         hash[k] *= 1099511628211ULL;
+      }
+   }
+}
+
+string CodeCache::entryName(const char *text, size_t length) {
+   unsigned long long hash[2] = { 14695981039346656037ULL, 0x6a09e667f3bcc908ULL };
+   hashBytes(hash, BUILD_ID, sizeof BUILD_ID);
+   char version = IMAGE_VERSION;
+   hashBytes(hash, &version, 1);
+   const char *end = text + length;
+   while (text < end) {
+      const char *newline = (const char *) memchr(text, '\n', end - text);
+      const char *stop = newline == nullptr ? end : newline;
+      if (stop > text) {
+         hashBytes(hash, text, stop - text);
+         hashBytes(hash, "\n", 1);
+      }
+      text = stop + 1;
+   }
+   char name[40];
+   snprintf(name, sizeof name, "%016llx%016llx.img", hash[0], hash[1]);
+   return name;
+}
+
+/*
+ * Implementation notes: evict
+ * ---------------------------
+ * Only the files the cache writes itself count toward the limit: the
+ * images, named by entryName, and the temporary files that saving them
+ * leaves behind after a crash, so that those are eventually deleted as
+ * well.  Anything else in the directory is left alone, since the
+ * directory may hold files of its own.  Files are deleted from the oldest
+ * modification time on until the rest fit.  The image that was just
+ * stored is kept, since the times only count seconds.
+ */
+
+static bool isDigits(const char *start, const char *end) {
+   if (start == end) return false;
+   for (const char *p = start; p < end; p++) {
+      if (!isdigit((unsigned char) *p)) return false;
+   }
+   return true;
+}
+
+static bool isEntryName(const char *name) {
+   for (int i = 0; i < 32; i++) {
+      if (!isdigit((unsigned char) name[i]) && (name[i] < 'a' || name[i] > 'f')) return false;
+   }
+   if (strncmp(name + 32, ".img", 4) != 0) return false;
+   const char *rest = name + 36;
+   if (*rest == '\0') return true;
+   if (*rest != '.') return false;
+   const char *dot = strchr(rest + 1, '.');
+   if (dot == nullptr || !isDigits(rest + 1, dot)) return false;
+   const char *suffix = strchr(dot + 1, '.');
+   return suffix != nullptr && isDigits(dot + 1, suffix) && strcmp(suffix, ".tmp") == 0;
+}
+
+void CodeCache::evict(const string & keep) {
+#ifndef _WIN32
+   DIR *dir = opendir(directory.c_str());
+   if (dir == nullptr) return;
+   vector<pair<time_t, pair<string, long long> > > files;
+   long long total = 0;
+   while (struct dirent *entry = readdir(dir)) {
+      if (!isEntryName(entry->d_name)) continue;
+      string path = directory + "/" + entry->d_name;
+      struct stat info;
+      if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+      total += info.st_size;
+      if (path != keep) files.push_back(make_pair(info.st_mtime, make_pair(path, (long long) info.st_size)));
+   }
+   closedir(dir);
+   if (total <= maxBytes) return;
+   sort(files.begin(), files.end());
+   for (size_t i = 0; i < files.size() && total > maxBytes; i++) {
+      if (remove(files[i].second.first.c_str()) != 0) continue;
+      total -= files[i].second.second;
+      evictions++;
+   }
+#endif
+}
@@ -0,0 +1,102 @@
+/*
+ * File: codecache.h
+ * -----------------
+ * This interface exports the CodeCache class, which keeps the program
+ * images of the programs run in batch mode in a directory, so that a
+ * program that has not changed is loaded from its image instead of
+ * being parsed again in the next process.
+ */
+
+#ifndef _codecache_h
+#define _codecache_h
+
+#include <string>
+#include "program.h"
+
+/*
+ * Class: CodeCache
+ * ----------------
+ * A CodeCache maps the text of a program to a program image (see
+ * image.h) in its directory.  The name of the image is a 128-bit hash
+ * of the build id of the interpreter and the text of the program with
+ * its blank lines dropped, since those are all that the parsed program
+ * depends on.  A new build therefore never loads an image written by
+ * an older one.
+ *
+ * Images are written under a temporary name and renamed into place, so
+ * a crash leaves either the whole image or none.  An image that fails
+ * to load is deleted and counted as a miss.  When the images take up
+ * more than the size limit, the least recently used ones are deleted;
+ * a hit marks its image as used by updating its modification time.
+ * Only the files named as the cache names them count toward the limit,
+ * so other files in the directory are never deleted.
+ *
+ * The cache is best effort: a directory that cannot be read or written
+ * only costs the time to parse the program.  On systems without POSIX
+ * directories, the cache never hits.
+ */
+
+class CodeCache {
+
+public:
+
+/*
+ * Constructor: CodeCache
+ * Usage: CodeCache cache(directory);
+ *        CodeCache cache(directory, maxBytes);
+ * --------------------------------------------
+ * Creates a cache that keeps at most maxBytes of images in directory,
+ * creating the directory if it does not exist.
+ */
+
+   CodeCache(const std::string & directory, long long maxBytes = 64 << 20);
+
+/*
+ * Method: load
+ * Usage: if (cache.load(program, text, length)) . . .
+ * ---------------------------------------------------
+ * Replaces the program with the cached image of the program text and
+ * returns true, or returns false if there is none.
+ */
+
+   bool load(Program & program, const char *text, size_t length);
+
+/*
+ * Method: store
+ * Usage: cache.store(program, text, length);
+ * ------------------------------------------
+ * Saves the image of the program, which must have been loaded from
+ * text without errors, and then trims the cache to its size limit.
+ */
+
+   void store(Program & program, const char *text, size_t length);
+
+/*
+ * Methods: getHits, getMisses, getStores, getEvictions
+ * Usage: long long n = cache.getHits();
+ * -------------------------------------
+ * Return the number of loads that found an image, the number that did
+ * not, the number of images written and the number deleted to stay
+ * under the size limit.
+ */
+
+   long long getHits();
+   long long getMisses();
+   long long getStores();
+   long long getEvictions();
+
+private:
+
+   std::string directory;
+   long long maxBytes;
+   long long hits, misses, stores, evictions;
+
+   std::string entryName(const char *text, size_t length);
+   void evict(const std::string & keep);
+
+   CodeCache(const CodeCache &);
+   CodeCache & operator=(const CodeCache &);
+
+};
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * File: compact.cpp
+ * -----------------
+ * This file implements the compact.h interface.
+ */
+
+#include <cctype>
+#include <cstring>
+#include <string>
+#include "compact.h"
+#include "evalstate.h"
+#include "../StanfordCPPLib/strlib.h"
+using namespace std;
+
+/*
+ * Implementation notes: the tokenized form
+ * ----------------------------------------
+ * Bytes below 0x80 stand for themselves.  The other bytes are tags:
+ *
+ *    KEYWORD + k          the k-th keyword
+ *    OPERATOR + k         the k-th character of OPERATORS
+ *    SHORT_SYMBOL + id    a variable whose symbol id is below 32
+ *    SYMBOL, NUMBER       a symbol id or a value as a varint
+ *    LINE_NUMBER          the line number
+ *    ESCAPE               a byte of the text that is 0x80 or above
+ *
+ * Adding SPACED to a tag other than ESCAPE means the token is followed
+ * by a space, which saves a byte on most tokens of a typical line; an
+ * OPERATOR tag is only used when a space follows.  A run that is neither
+ * a keyword, a variable nor a number in canonical form, such as 007 or
+ * 2x, is kept as it is.
+ */
+
+static const unsigned char KEYWORD = 0x80;
+static const unsigned char OPERATOR = 0x90;
+static const unsigned char SHORT_SYMBOL = 0xA0;
+static const unsigned char LINE_NUMBER = 0xE0;
+static const unsigned char SYMBOL = 0xF0;
+static const unsigned char NUMBER = 0xF2;
+static const unsigned char ESCAPE = 0xFF;
+
+static const int KEYWORDS = 8;
+static const char *const KEYWORD_NAMES[KEYWORDS] = {
+   "REM", "LET", "PRINT", "INPUT", "GOTO", "IF", "THEN", "END"
+};
+
+static const char OPERATORS[] = "=+-*/()<>";
+static const int SHORT_SYMBOLS = 32;
+
+static int spacedFlag(unsigned char tag) {
+   if (tag < OPERATOR) return 0x08;
+   if (tag < SHORT_SYMBOL) return 0;
+   if (tag < LINE_NUMBER) return SHORT_SYMBOLS;
+   return tag < SYMBOL ? 0 : 1;
+}
+
+static void putNumber(string & code, unsigned value) {
+   while (value >= 0x80) {
+      code += (char) (value | 0x80);
+      value >>= 7;
+   }
+   code += (char) value;
+}
+
+static unsigned getNumber(const string & code, size_t & i) {
+   unsigned value = 0;
+   for (int shift = 0; ; shift += 7) {
+      unsigned char byte = code[i++];
+      value |= (unsigned) (byte & 0x7F) << shift;
+      if (byte < 0x80) return value;
+   }
+}
+
+static void putText(string & code, const char *text, size_t length) {
+   for (size_t i = 0; i < length; i++) {
+      if ((unsigned char) text[i] >= 0x80) code += (char) ESCAPE;
+      code += text[i];
+   }
+}
+
+/*
+ * Implementation notes: compactLine
+ * ---------------------------------
+ * A number is only tokenized if it fits in an int and has no leading
+ * zeros, since expandLine writes it back in canonical form.  Variables
+ * are the runs that start with a letter, as in the token scanner.  The
+ * tag of each token is written before the token is known to be followed
+ * by a space and fixed afterwards.  The result is trimmed to its length,
+ * since it is kept for as long as the line.
+ */
+
+static bool isCanonicalNumber(const char *run, size_t length, unsigned & value) {
+   if (length > 10 || (run[0] == '0' && length > 1)) return false;
+   unsigned long long total = 0;
+   for (size_t i = 0; i < length; i++) {
+      if (!isdigit((unsigned char) run[i])) return false;
+      total = total * 10 + (run[i] - '0');
+   }
+   if (total > 0x7FFFFFFF) return false;
+   value = (unsigned) total;
+   return true;
+}
+
+string compactLine(int lineNumber, const string & text) {
+   string code;
+   const char *p = text.data();
+   const char *end = p + text.length();
+   char prefix[MAX_INTEGER_LENGTH];
+   size_t length = formatInteger(lineNumber, prefix);
+   if (text.length() > length && memcmp(p, prefix, length) == 0 && p[length] == ' ') {
+      code += (char) LINE_NUMBER;
+      p += length + 1;
+   }
+   while (p < end) {
+      size_t tag = code.length();
+      if (!isalnum((unsigned char) *p)) {
+         const char *op = strchr(OPERATORS, *p);
+         if (*p != '\0' && op != nullptr && p + 1 < end && p[1] == ' ') {
+            code += (char) (OPERATOR + (op - OPERATORS));
+            p += 2;
+         } else {
+            putText(code, p, 1);
+            p++;
+         }
+         continue;
+      }
+      const char *run = p;
+      while (p < end && isalnum((unsigned char) *p)) p++;
+      length = p - run;
+      unsigned value;
+      int k = 0;
+      while (k < KEYWORDS && (strlen(KEYWORD_NAMES[k]) != length
+                              || memcmp(KEYWORD_NAMES[k], run, length) != 0)) {
+         k++;
+      }
+      if (k == 0) {
+         code += (char) KEYWORD;
+         putText(code, p, end - p);
+         break;
+      } else if (k < KEYWORDS) {
+         code += (char) (KEYWORD + k);
+      } else if (isdigit((unsigned char) run[0])) {
+         if (!isCanonicalNumber(run, length, value)) {
+            putText(code, run, length);
+            continue;
+         }
+         code += (char) NUMBER;
+         putNumber(code, value);
+      } else {
+         int id = internSymbol(string(run, length));
+         if (id < SHORT_SYMBOLS) {
+            code += (char) (SHORT_SYMBOL + id);
+         } else {
+            code += (char) SYMBOL;
+            putNumber(code, id);
+         }
+      }
+      if (p < end && *p == ' ') {
+         code[tag] = (char) (code[tag] + spacedFlag(code[tag]));
+         p++;
+      }
+   }
+   code.shrink_to_fit();
+   return code;
+}
+
+string expandLine(int lineNumber, const string & code) {
+   string text;
+   char buffer[MAX_INTEGER_LENGTH];
+   size_t i = 0;
+   while (i < code.length()) {
+      unsigned char byte = code[i++];
+      if (byte < KEYWORD) {
+         text += (char) byte;
+         continue;
+      } else if (byte == ESCAPE) {
+         text += code[i++];
+         continue;
+      }
+      bool spaced = true;
+      if (byte < OPERATOR) {
+         spaced = (byte & 0x08) != 0;
+         text += KEYWORD_NAMES[byte & 0x07];
+      } else if (byte < SHORT_SYMBOL) {
+         text += OPERATORS[byte - OPERATOR];
+      } else if (byte < LINE_NUMBER) {
+         spaced = byte - SHORT_SYMBOL >= SHORT_SYMBOLS;
+         text += symbolName((byte - SHORT_SYMBOL) % SHORT_SYMBOLS);
+      } else if (byte == LINE_NUMBER) {
+         text.append(buffer, formatInteger(lineNumber, buffer));
+      } else {
+         spaced = (byte - SYMBOL) % 2 != 0;
+         if (byte - SYMBOL < 2) {
+            text += symbolName(getNumber(code, i));
+         } else {
+            text.append(buffer, formatInteger(getNumber(code, i), buffer));
+         }
+      }
+      if (spaced) text += ' ';
+   }
+   return text;
+}
@@ -0,0 +1,39 @@
+/*
+ * File: compact.h
+ * ---------------
+ * This interface exports functions that store the text of a program
+ * line in tokenized form, the way classic BASIC interpreters did, and
+ * restore it exactly.
+ */
+
+#ifndef _compact_h
+#define _compact_h
+
+#include <string>
+
+/*
+ * Function: compactLine
+ * Usage: string code = compactLine(lineNumber, text);
+ * ---------------------------------------------------
+ * Returns the tokenized form of a line of text.  Every maximal run of
+ * letters and digits is replaced by a single keyword byte, by the
+ * interned symbol id of a variable, or by the value of a number written
+ * without leading zeros, and a space after a token or an operator is
+ * folded into it; everything after REM is kept as it is.  The line
+ * number at the start of the text takes a single byte.  For typical
+ * lines, the result fits in the string itself and needs no storage of
+ * its own.
+ */
+
+std::string compactLine(int lineNumber, const std::string & text);
+
+/*
+ * Function: expandLine
+ * Usage: string text = expandLine(lineNumber, code);
+ * --------------------------------------------------
+ * Returns the text that compactLine turned into code, byte for byte.
+ */
+
+std::string expandLine(int lineNumber, const std::string & code);
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * File: digest.cpp
+ * ----------------
+ * This file implements the digest.h interface.
+ */
+
+#include <cstdio>
+#include <string>
+#include "digest.h"
+using namespace std;
+
+string Digest::toString() const {
+   char buffer[33];
+   snprintf(buffer, sizeof buffer, "%016llx%016llx", high, low);
+   return buffer;
+}
+
+/*
+ * Implementation notes: lineDigest
+ * --------------------------------
+ * Each half is a 64-bit FNV-1a hash of the line number and the text,
+ * started from a different offset and finished with the final mixing
+ * step of MurmurHash3, so that every bit of the input reaches every bit
+ * of the sums the tree keeps.
+ */
+
+static unsigned long long finish(unsigned long long hash) {
+   hash ^= hash >> 33;
+   hash *= 0xff51afd7ed558ccdULL;
+   hash ^= hash >> 33;
+   hash *= 0xc4ceb9fe1a85ec53ULL;
+   hash ^= hash >> 33;
+   return hash;
+}
+
+Digest lineDigest(int lineNumber, const string & text) {
+   unsigned long long hash[2] = { 14695981039346656037ULL, 0x6a09e667f3bcc908ULL };
+   unsigned bits = lineNumber;
+   for (int k = 0; k < 2; k++) {
+      for (int i = 0; i < 4; i++) {
+         hash[k] ^= (bits >> (8 * i)) & 0xff;
+         hash[k] *= 1099511628211ULL;
+      }
+      for (size_t i = 0; i < text.length(); i++) {
+         hash[k] ^= (unsigned char) text[i];
+         hash[k] *= 1099511628211ULL;
+      }
+   }
+   Digest digest = { finish(hash[0]), finish(hash[1]) };
+   return digest;
+}
+
+static Digest add(const Digest & a, const Digest & b) {
+   Digest sum = { a.high + b.high, a.low + b.low };
+   return sum;
+}
+
+static Digest subtract(const Digest & a, const Digest & b) {
+   Digest difference = { a.high - b.high, a.low - b.low };
+   return difference;
+}
+
+static const Digest ZERO = { 0, 0 };
+
+DigestTree::DigestTree() {
+   root = nullptr;
+}
+
+DigestTree::~DigestTree() {
+   clear();
+}
+
+void DigestTree::set(int lineNumber, const Digest & digest) {
+   Node *line = new Node;
+   line->lineNumber = lineNumber;
+   line->priority = (unsigned) finish((unsigned) lineNumber + 0x9e3779b97f4a7c15ULL);
+   line->digest = line->sum = digest;
+   line->left = line->right = nullptr;
+   root = insert(root, line);
+}
+
+void DigestTree::remove(int lineNumber) {
+   root = erase(root, lineNumber);
+}
+
+void DigestTree::clear() {
+   freeNodes(root);
+   root = nullptr;
+}
+
+Digest DigestTree::getDigest() {
+   return root == nullptr ? ZERO : root->sum;
+}
+
+Digest DigestTree::getDigest(int first, int last) {
+   if (first > last) return ZERO;
+   return subtract(sumBefore(root, (long long) last + 1), sumBefore(root, first));
+}
+
+/*
+ * Implementation notes: insert, erase
+ * -----------------------------------
+ * These are the usual treap operations: a new line goes in as a leaf
+ * and is rotated up while its priority is higher than its parent's, and
+ * a line to be removed is rotated down below the child with the higher
+ * priority until it has at most one child.  Every node on the path has
+ * its sum recomputed on the way back up.
+ */
+
+DigestTree::Node *DigestTree::insert(Node *node, Node *line) {
+   if (node == nullptr) return line;
+   if (line->lineNumber == node->lineNumber) {
+      node->digest = line->digest;
+      delete line;
+   } else if (line->lineNumber < node->lineNumber) {
+      node->left = insert(node->left, line);
+      if (node->left->priority > node->priority) node = rotateRight(node);
+   } else {
+      node->right = insert(node->right, line);
+      if (node->right->priority > node->priority) node = rotateLeft(node);
+   }
+   update(node);
+   return node;
+}
+
+DigestTree::Node *DigestTree::erase(Node *node, int lineNumber) {
+   if (node == nullptr) return nullptr;
+   if (lineNumber < node->lineNumber) {
+      node->left = erase(node->left, lineNumber);
+   } else if (lineNumber > node->lineNumber) {
+      node->right = erase(node->right, lineNumber);
+   } else if (node->left == nullptr || node->right == nullptr) {
+      Node *child = node->left == nullptr ? node->right : node->left;
+      delete node;
+      return child;
+   } else if (node->left->priority > node->right->priority) {
+      node = rotateRight(node);
+      node->right = erase(node->right, lineNumber);
+   } else {
+      node = rotateLeft(node);
+      node->left = erase(node->left, lineNumber);
+   }
+   update(node);
+   return node;
+}
+
+DigestTree::Node *DigestTree::rotateLeft(Node *node) {
+   Node *child = node->right;
+   node->right = child->left;
+   update(node);
+   child->left = node;
+   return child;
+}
+
+DigestTree::Node *DigestTree::rotateRight(Node *node) {
+   Node *child = node->left;
+   node->left = child->right;
+   update(node);
+   child->right = node;
+   return child;
+}
+
+/*
+ * Implementation notes: sumBefore
+ * -------------------------------
+ * Returns the sum of the lines numbered below limit by walking down a
+ * single path and adding up the left subtrees it passes.
+ */
+
+Digest DigestTree::sumBefore(Node *node, long long limit) {
+   Digest sum = ZERO;
+   while (node != nullptr) {
+      if (node->lineNumber < limit) {
+         if (node->left != nullptr) sum = add(sum, node->left->sum);
+         sum = add(sum, node->digest);
+         node = node->right;
+      } else {
+         node = node->left;
+      }
+   }
+   return sum;
+}
+
+void DigestTree::update(Node *node) {
+   node->sum = node->digest;
+   if (node->left != nullptr) node->sum = add(node->sum, node->left->sum);
+   if (node->right != nullptr) node->sum = add(node->sum, node->right->sum);
+}
+
+void DigestTree::freeNodes(Node *node) {
+   while (node != nullptr) {
+      freeNodes(node->left);
+      Node *right = node->right;
+      delete node;
+      node = right;
+   }
+}
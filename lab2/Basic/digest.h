@@ -0,0 +1,140 @@
+/*
+ * File: digest.h
+ * --------------
+ * This interface exports the Digest type and the DigestTree class, which
+ * keeps a digest of every line of a program so that the digest of the
+ * whole program, or of any range of its lines, is available at once.
+ */
+
+#ifndef _digest_h
+#define _digest_h
+
+#include <string>
+
+/*
+ * Type: Digest
+ * ------------
+ * A 128-bit digest, kept as two 64-bit halves.  Two programs with the
+ * same digest can be taken to hold the same lines.
+ */
+
+struct Digest {
+   unsigned long long high, low;
+
+   bool operator==(const Digest & other) const {
+      return high == other.high && low == other.low;
+   }
+
+   bool operator!=(const Digest & other) const {
+      return !(*this == other);
+   }
+
+/*
+ * Method: toString
+ * Usage: string hex = digest.toString();
+ * --------------------------------------
+ * Returns the digest as 32 hexadecimal digits.
+ */
+
+   std::string toString() const;
+};
+
+/*
+ * Function: lineDigest
+ * Usage: Digest digest = lineDigest(lineNumber, text);
+ * ----------------------------------------------------
+ * Returns the digest of one program line, which covers both its number
+ * and its text.
+ */
+
+Digest lineDigest(int lineNumber, const std::string & text);
+
+/*
+ * Class: DigestTree
+ * -----------------
+ * A DigestTree holds the digest of every line of a program, ordered by
+ * line number, and the digest of each subtree, which is the sum of the
+ * line digests in it.  Since the line digests cover the line numbers,
+ * the sum identifies the lines without depending on the order in which
+ * they were added, so the digest of a program or of a range of its
+ * lines is the same however the program was typed.
+ *
+ * The tree is a treap whose priorities are computed from the line
+ * numbers, so every operation takes O(log n) expected time and the
+ * digest of the whole program takes constant time.
+ */
+
+class DigestTree {
+
+public:
+
+/*
+ * Constructor: DigestTree
+ * Usage: DigestTree tree;
+ * -----------------------
+ * Creates an empty tree.
+ */
+
+   DigestTree();
+
+/*
+ * Destructor: ~DigestTree
+ * Usage: usually implicit
+ * -----------------------
+ * Frees the nodes of the tree.
+ */
+
+   ~DigestTree();
+
+/*
+ * Methods: set, remove, clear
+ * Usage: tree.set(lineNumber, digest);
+ *        tree.remove(lineNumber);
+ *        tree.clear();
+ * ----------------------------------
+ * set adds a line or replaces the digest of an existing one, remove
+ * drops a line if it is there and clear drops every line.
+ */
+
+   void set(int lineNumber, const Digest & digest);
+   void remove(int lineNumber);
+   void clear();
+
+/*
+ * Methods: getDigest
+ * Usage: Digest digest = tree.getDigest();
+ *        Digest digest = tree.getDigest(first, last);
+ * ---------------------------------------------------
+ * Returns the digest of every line, or of the lines numbered from
+ * first to last inclusive.  The digest of no lines is all zeros.
+ */
+
+   Digest getDigest();
+   Digest getDigest(int first, int last);
+
+private:
+
+   struct Node {
+      int lineNumber;
+      unsigned priority;
+      Digest digest;
+      Digest sum;
+      Node *left, *right;
+   };
+
+   Node *root;
+
+   static Node *insert(Node *node, Node *line);
+   static Node *erase(Node *node, int lineNumber);
+   static Node *rotateLeft(Node *node);
+   static Node *rotateRight(Node *node);
+   static Digest sumBefore(Node *node, long long limit);
+   static void update(Node *node);
+   static void freeNodes(Node *node);
+
+   DigestTree(const DigestTree &);
+   DigestTree & operator=(const DigestTree &);
+
+};
+
+#endif
@@ -2,34 +2,361 @@
  * File: evalstate.cpp
  * -------------------
  * This file implements the EvalState class, which defines a symbol
- * table for keeping track of the value of identifiers.  The public
- * methods are simple enough that they need no individual documentation.
+ * table for keeping track of the value of identifiers, together with
+ * the table of interned names.  The public methods are simple enough
+ * that they need no individual documentation.
  */
 
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "evalstate.h"
-
-#include "../StanfordCPPLib/map.h"
 using namespace std;
 
-/* Implementation of the EvalState class */
+/*
+ * Implementation notes: the symbol table
+ * --------------------------------------
+ * Interned names live in a deque, so that the references returned by
+ * symbolName stay valid while new names are added.  The index from
+ * names to ids is itself an open-addressing table that stores the id
+ * of each name; the FNV-1a hash of every name is kept alongside it, so
+ * that growing the index never rehashes a string and most probes that
+ * miss are rejected without comparing characters.
+ *
+ * The current table is a thread-local pointer, which is nullptr unless
+ * a scope has set it; the shared table is created on first use, so that
+ * it exists before any static statement is parsed.
+ */
 
-EvalState::EvalState() {
+static thread_local SymbolTable *currentTable = nullptr;
+
+static SymbolTable & sharedTable() {
+   static SymbolTable table;
+   return table;
+}
+
+static SymbolTable & symbols() {
+   return currentTable != nullptr ? *currentTable : sharedTable();
+}
+
+static unsigned hashName(const string & name) {
+   unsigned hash = 2166136261u;
+   for (size_t i = 0; i < name.length(); i++) {
+      hash ^= (unsigned char) name[i];
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+SymbolTable::SymbolTable() : index(64, -1) {
    /* Empty */
 }
 
+int SymbolTable::probe(const string & name, unsigned hash) {
+   int mask = index.size() - 1;
+   int i = hash & mask;
+   while (true) {
+      int symbol = index[i];
+      if (symbol < 0) return i;
+      if (hashes[symbol] == hash && names[symbol] == name) return i;
+      i = (i + 1) & mask;
+   }
+}
+
+int SymbolTable::intern(const string & name) {
+   lock_guard<mutex> guard(lock);
+   unsigned hash = hashName(name);
+   int i = probe(name, hash);
+   if (index[i] >= 0) return index[i];
+   int symbol = names.size();
+   names.push_back(name);
+   hashes.push_back(hash);
+   index[i] = symbol;
+   if (2 * names.size() > index.size()) {
+      index.assign(2 * index.size(), -1);
+      int mask = index.size() - 1;
+      for (int id = 0; id <= symbol; id++) {
+         int j = hashes[id] & mask;
+         while (index[j] >= 0) j = (j + 1) & mask;
+         index[j] = id;
+      }
+   }
+   return symbol;
+}
+
+int SymbolTable::find(const string & name) {
+   lock_guard<mutex> guard(lock);
+   return index[probe(name, hashName(name))];
+}
+
+const string & SymbolTable::getName(int symbol) {
+   lock_guard<mutex> guard(lock);
+   return names[symbol];
+}
+
+int SymbolTable::size() {
+   lock_guard<mutex> guard(lock);
+   return names.size();
+}
+
+SymbolScope::SymbolScope(SymbolTable & table) {
+   saved = currentTable;
+   currentTable = &table;
+}
+
+SymbolScope::~SymbolScope() {
+   currentTable = saved;
+}
+
+int internSymbol(const string & name) {
+   return symbols().intern(name);
+}
+
+int findSymbol(const string & name) {
+   return symbols().find(name);
+}
+
+const string & symbolName(int symbol) {
+   return symbols().getName(symbol);
+}
+
+/*
+ * Implementation notes: the EvalState class
+ * -----------------------------------------
+ * Slots are placed by Fibonacci hashing of the symbol id, which spreads
+ * the consecutive ids the parser hands out over the whole table.  The
+ * table is kept at most half full, so probe sequences stay short, and
+ * erase shifts the following entries back instead of leaving markers.
+ *
+ * A slot whose generation is not the current one is free, whatever it
+ * still holds.  Since clear frees every slot at once, the entries of
+ * the current generation always form unbroken probe sequences, exactly
+ * as if the table had been emptied.  Empty slots carry generation 0,
+ * which is never current; when the counter wraps around, the slots are
+ * really emptied once.
+ *
+ * touch gives the state a fresh structural version after every change
+ * that moves or frees a slot.  The 64-bit counter cannot wrap in any
+ * realistic run, so a cached version is never mistaken for a new one.
+ */
+
+static atomic<unsigned long long> versionCounter(0);
+
+static const int INITIAL_BITS = 4;
+
+EvalState::EvalState() {
+   reset();
+   cacheHits = cacheMisses = 0;
+   output = &standardOutput();
+   input = &standardInput();
+   jumpTarget = 0;
+   jumping = ended = false;
+   suspendable = prompted = false;
+   slice = statements = 0;
+}
+
+EvalState::EvalState(const EvalState & src) {
+   *this = src;
+}
+
+EvalState & EvalState::operator=(const EvalState & src) {
+   if (this == &src) return *this;
+   src.dir->shared.store(true, memory_order_release);
+   attach(src.dir);
+   capacity = src.capacity;
+   generation = src.generation;
+   count = src.count;
+   shift = src.shift;
+   cacheHits = src.cacheHits;
+   cacheMisses = src.cacheMisses;
+   output = src.output;
+   input = src.input;
+   jumpTarget = src.jumpTarget;
+   jumping = src.jumping;
+   ended = src.ended;
+   suspendable = src.suspendable;
+   prompted = src.prompted;
+   slice = src.slice;
+   statements = src.statements;
+   touch();
+   return *this;
+}
+
 EvalState::~EvalState() {
    /* Empty */
 }
 
-void EvalState::setValue(string var, int value) {
-   symbolTable.put(var, value);
+const int *EvalState::lookup(const string & var) {
+   int symbol = findSymbol(var);
+   return symbol < 0 ? nullptr : lookup(symbol);
+}
+
+int *EvalState::modify(int symbol) {
+   int i = find(symbol);
+   return i < 0 ? nullptr : &writable(i).value;
+}
+
+void EvalState::setValue(int symbol, int value) {
+   int mask = capacity - 1;
+   int i = home(symbol);
+   while (at(i).generation == generation) {
+      if (at(i).symbol == symbol) {
+         writable(i).value = value;
+         return;
+      }
+      i = (i + 1) & mask;
+   }
+   Slot &slot = writable(i);
+   slot.symbol = symbol;
+   slot.value = value;
+   slot.generation = generation;
+   if (2 * ++count > capacity) {
+      grow();
+      touch();
+   }
+}
+
+void EvalState::setValue(const string & var, int value) {
+   setValue(internSymbol(var), value);
+}
+
+int EvalState::getValue(const string & var) {
+   const int *cell = lookup(var);
+   return cell == nullptr ? 0 : *cell;
+}
+
+bool EvalState::isDefined(const string & var) {
+   return lookup(var) != nullptr;
+}
+
+void EvalState::clear() {
+   count = 0;
+   if (++generation == 0) reset();
+   touch();
+}
+
+void EvalState::erase(const string & var) {
+   int symbol = findSymbol(var);
+   int hole = symbol < 0 ? -1 : find(symbol);
+   if (hole < 0) return;
+   int mask = capacity - 1;
+   for (int i = (hole + 1) & mask; at(i).generation == generation; i = (i + 1) & mask) {
+      int want = home(at(i).symbol);
+      if (((i - want) & mask) >= ((i - hole) & mask)) {
+         Slot moved = at(i);
+         writable(hole) = moved;
+         hole = i;
+      }
+   }
+   writable(hole).generation = 0;
+   count--;
+   touch();
+}
+
+int EvalState::size() {
+   return count;
+}
+
+int EvalState::find(int symbol) const {
+   int mask = capacity - 1;
+   for (int i = home(symbol); ; i = (i + 1) & mask) {
+      const Slot &slot = at(i);
+      if (slot.generation != generation) return -1;
+      if (slot.symbol == symbol) return i;
+   }
+}
+
+/*
+ * Implementation notes: unshare
+ * -----------------------------
+ * A state owns its directory outright unless the directory is marked as
+ * shared, which copying a state does to the directory of the original.
+ * The owned flags of an unshared directory record the pages that no
+ * other directory refers to; writable only takes the slow path below
+ * when either test fails.
+ *
+ * A shared directory is copied, which only copies the page pointers, so
+ * the cells stay where they were.  If every other state has dropped the
+ * directory in the meantime, it is taken back instead, but its pages
+ * may have been copied into other directories, so none of them counts
+ * as owned any more.  A page is owned again once its use count shows
+ * that no other directory refers to it, or after it has been copied,
+ * which moves its cells and so changes the version.  The fence orders
+ * the writes that follow after everything the last other owner did
+ * before it let go.
+ */
+
+void EvalState::unshare(int page) {
+   if (dir->shared.load(memory_order_acquire)) {
+      if (dir.use_count() > 1) {
+         shared_ptr<Directory> copy = make_shared<Directory>();
+         copy->pages = dir->pages;
+         copy->raw = dir->raw;
+         copy->owned.assign(dir->owned.size(), 0);
+         copy->shared = false;
+         attach(copy);
+      } else {
+         dir->owned.assign(dir->owned.size(), 0);
+         dir->shared = false;
+      }
+   }
+   if (!owned[page]) {
+      shared_ptr<Page> &slots = dir->pages[page];
+      if (slots.use_count() > 1) {
+         slots = make_shared<Page>(*slots);
+         raw[page] = &(*slots)[0];
+         touch();
+      }
+      atomic_thread_fence(memory_order_acquire);
+      owned[page] = 1;
+   }
+}
+
+void EvalState::attach(const shared_ptr<Directory> & dir) {
+   this->dir = dir;
+   raw = &dir->raw[0];
+   owned = &dir->owned[0];
+}
+
+void EvalState::allocate(int capacity) {
+   Slot empty = { -1, 0, 0 };
+   int pageSize = capacity < PAGE_SLOTS ? capacity : PAGE_SLOTS;
+   shared_ptr<Directory> fresh = make_shared<Directory>();
+   for (int i = 0; i < capacity; i += pageSize) {
+      fresh->pages.push_back(make_shared<Page>(pageSize, empty));
+      fresh->raw.push_back(&(*fresh->pages.back())[0]);
+   }
+   fresh->owned.assign(fresh->pages.size(), 1);
+   fresh->shared = false;
+   attach(fresh);
+   this->capacity = capacity;
+}
+
+void EvalState::grow() {
+   shared_ptr<Directory> old = dir;
+   int oldCapacity = capacity;
+   allocate(2 * capacity);
+   shift--;
+   int mask = capacity - 1;
+   for (int j = 0; j < oldCapacity; j++) {
+      const Slot &slot = old->raw[j >> PAGE_BITS][j & (PAGE_SLOTS - 1)];
+      if (slot.generation != generation) continue;
+      int i = home(slot.symbol);
+      while (at(i).generation == generation) i = (i + 1) & mask;
+      writable(i) = slot;
+   }
 }
 
-int EvalState::getValue(string var) {
-   return symbolTable.get(var);
+void EvalState::reset() {
+   allocate(1 << INITIAL_BITS);
+   generation = 1;
+   count = 0;
+   shift = 32 - INITIAL_BITS;
+   touch();
 }
 
-bool EvalState::isDefined(string var) {
-   return symbolTable.containsKey(var);
+void EvalState::touch() {
+   version = ++versionCounter;
 }
@@ -9,8 +9,108 @@
 #ifndef _evalstate_h
 #define _evalstate_h
 
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
-#include "../StanfordCPPLib/map.h"
+#include <vector>
+#include "input.h"
+#include "output.h"
+
+/*
+ * Function: internSymbol
+ * Usage: int symbol = internSymbol(name);
+ * ---------------------------------------
+ * Returns the symbol id of a variable name.  The first call for a name
+ * assigns it the next free id, starting at 0, and the id never changes
+ * afterwards.  The parser interns every name it reads, so the evaluator
+ * can look variables up by id instead of by string.  The names are kept
+ * in the symbol table that is current on the calling thread (see
+ * SymbolScope below), or in a table shared by the whole process if no
+ * table is current.
+ */
+
+int internSymbol(const std::string & name);
+
+/*
+ * Function: findSymbol
+ * Usage: int symbol = findSymbol(name);
+ * -------------------------------------
+ * Returns the symbol id of a name, or -1 if the name has never been
+ * interned.  Unlike internSymbol, this function allocates nothing.
+ */
+
+int findSymbol(const std::string & name);
+
+/*
+ * Function: symbolName
+ * Usage: string name = symbolName(symbol);
+ * ----------------------------------------
+ * Returns the name of an interned symbol.
+ */
+
+const std::string & symbolName(int symbol);
+
+/*
+ * Class: SymbolTable
+ * ------------------
+ * A table of interned names.  Ids are only meaningful in the table that
+ * assigned them, so statements parsed with one table must only run on
+ * states that use the same one.  The names are freed with the table,
+ * which is how a server that runs many sessions gets back the names a
+ * session has used once it ends.  A table may be used from several
+ * threads.
+ */
+
+class SymbolTable {
+
+public:
+
+   SymbolTable();
+
+   int intern(const std::string & name);
+   int find(const std::string & name);
+   const std::string & getName(int symbol);
+   int size();
+
+private:
+
+   std::mutex lock;
+   std::deque<std::string> names;
+   std::vector<unsigned> hashes;
+   std::vector<int> index;
+
+   int probe(const std::string & name, unsigned hash);
+
+   SymbolTable(const SymbolTable &);
+   SymbolTable & operator=(const SymbolTable &);
+
+};
+
+/*
+ * Class: SymbolScope
+ * ------------------
+ * Makes a table current on the calling thread for as long as the scope
+ * lasts, so that internSymbol, findSymbol and symbolName use it.  Scopes
+ * nest; the table that was current before is restored at the end.
+ */
+
+class SymbolScope {
+
+public:
+
+   explicit SymbolScope(SymbolTable & table);
+   ~SymbolScope();
+
+private:
+
+   SymbolTable *saved;
+
+   SymbolScope(const SymbolScope &);
+   SymbolScope & operator=(const SymbolScope &);
+
+};
 
 /*
  * Class: EvalState
@@ -18,10 +118,27 @@
  * This class is passed by reference through the recursive levels
  * of the evaluator and contains information from the evaluation
  * environment that the evaluator may need to know.  In this
- * version, the only information maintained by the EvalState class
- * is a symbol table that maps variable names into their values.
- * Several of the exercises, however, require you to include
- * additional information in the EvalState class.
+ * version, the EvalState class maintains a symbol table that maps
+ * variables into their values, together with the jump and end
+ * requests of the running program.
+ *
+ * Variables are keyed by their interned symbol ids.  The table uses
+ * open addressing with linear probing over a power-of-two array of
+ * slots, each holding an id and its value, so that a lookup is one
+ * multiplication and usually one cache line.
+ *
+ * Every slot is stamped with the generation of the table that filled
+ * it, and only slots of the current generation count as occupied.
+ * clear therefore just starts a new generation: the storage is reused
+ * as it is, and its size stays that of the largest table so far.
+ *
+ * The slots are stored in pages of at most PAGE_SLOTS entries, which
+ * are shared copy-on-write between an EvalState and its copies.
+ * Copying a state, which is how a run forks a prepared state, only
+ * shares the page directory, whatever the number of variables.  The
+ * first write to a shared directory or page copies that piece alone.
+ * Copies never see each other's changes and may be used from
+ * different threads.
  */
 
 class EvalState {
@@ -46,6 +163,43 @@ public:
 
    ~EvalState();
 
+/*
+ * Constructor: EvalState
+ * Usage: EvalState fork = state;
+ *        fork = state;
+ * -------------------------------
+ * Makes a snapshot of another state in constant time.  The variables
+ * are shared with the original until either side changes them.
+ */
+
+   EvalState(const EvalState & src);
+   EvalState & operator=(const EvalState & src);
+
+/*
+ * Method: lookup
+ * Usage: const int *cell = state.lookup(symbol);
+ * ----------------------------------------------
+ * Returns a pointer to the value of the variable, or nullptr if the
+ * variable is not defined.  The pointer stays valid until the version
+ * of the state changes (see getVersion).  The string version looks the
+ * name up without interning it.
+ */
+
+   const int *lookup(int symbol);
+   const int *lookup(const std::string & var);
+
+/*
+ * Method: modify
+ * Usage: int *cell = state.modify(symbol);
+ * ----------------------------------------
+ * Returns a pointer through which the value of a defined variable can
+ * be changed, or nullptr if the variable is not defined.  If the value
+ * is shared with a snapshot, it is unshared first, which changes the
+ * version of the state.
+ */
+
+   int *modify(int symbol);
+
 /*
  * Method: setValue
  * Usage: state.setValue(var, value);
@@ -53,16 +207,18 @@ public:
  * Sets the value associated with the specified var.
  */
 
-   void setValue(std::string var, int value);
+   void setValue(int symbol, int value);
+   void setValue(const std::string & var, int value);
 
 /*
  * Method: getValue
  * Usage: int value = state.getValue(var);
  * ---------------------------------------
- * Returns the value associated with the specified variable.
+ * Returns the value associated with the specified variable, or 0 if the
+ * variable is not defined.
  */
 
-   int getValue(std::string var);
+   int getValue(const std::string & var);
 
 /*
  * Method: isDefined
@@ -71,13 +227,207 @@ public:
  * Returns true if the specified variable is defined.
  */
 
-   bool isDefined(std::string var);
-   void clear() { symbolTable.clear(); }
-   void erase(std::string var);
+   bool isDefined(const std::string & var);
+
+/*
+ * Methods: clear, erase, size
+ * Usage: state.clear();
+ *        state.erase(var);
+ *        int n = state.size();
+ * ----------------------------
+ * clear removes every variable in constant time, and erase a single
+ * one.  size returns the number of variables that are defined.
+ */
+
+   void clear();
+   void erase(const std::string & var);
+   int size();
+
+/*
+ * Method: getVersion
+ * Usage: if (cachedVersion == state.getVersion()) . . .
+ * -----------------------------------------------------
+ * Returns the structural version of the table.  The version changes
+ * whenever a pointer returned by lookup may become invalid, which is
+ * when a variable is erased, when the table grows, when the state is
+ * cleared or copied and when shared storage is unshared.  Adding a
+ * variable without growing and changing a value leave it alone.  Versions
+ * are drawn from a counter shared by every EvalState, so no two states
+ * ever have the same version and a pointer cached together with the
+ * version can be reused as long as the version matches.
+ */
+
+   unsigned long long getVersion() { return version; }
+
+/*
+ * Methods: getOutput, setOutput
+ * Usage: state.getOutput().writeLine(str);
+ *        state.setOutput(out);
+ * ----------------------------------------
+ * Give access to the sink that PRINT and the other statements write
+ * to.  A new state writes to standardOutput(); the sink is not owned by
+ * the state and must outlive it.
+ */
+
+   OutputSink & getOutput() { return *output; }
+   void setOutput(OutputSink & out) { output = &out; }
+
+/*
+ * Methods: getInput, setInput
+ * Usage: state.getInput().readLine(line);
+ *        state.setInput(input);
+ * ---------------------------------------
+ * Give access to the reader that INPUT takes its answers from, which is
+ * standardInput() for a new state.  Like the sink, the reader is not
+ * owned by the state.
+ */
+
+   LineReader & getInput() { return *input; }
+   void setInput(LineReader & reader) { input = &reader; }
+
+/*
+ * Methods: recordCacheHit, recordCacheMiss, getCacheHits, getCacheMisses
+ * Usage: state.recordCacheHit();
+ * ----------------------------------------------------------------------
+ * Count the hits and misses of the inline caches that expressions keep
+ * on this state, so that their hit rate can be checked.
+ */
+
+   void recordCacheHit() { cacheHits++; }
+   void recordCacheMiss() { cacheMisses++; }
+   long long getCacheHits() { return cacheHits; }
+   long long getCacheMisses() { return cacheMisses; }
+
+/*
+ * Methods: requestJump, hasJump, takeJump
+ * Usage: state.requestJump(lineNumber);
+ *        if (state.hasJump()) lineNumber = state.takeJump();
+ * ---------------------------------------------------------
+ * GOTO and IF statements use requestJump to tell the running program
+ * which line to continue from.  The program checks for the request with
+ * hasJump and consumes it with takeJump, which returns the target line.
+ */
+
+   void requestJump(int lineNumber) { jumpTarget = lineNumber; jumping = true; }
+   bool hasJump() { return jumping; }
+   int takeJump() { jumping = false; return jumpTarget; }
+
+/*
+ * Methods: requestEnd, hasEnded, resetControl
+ * Usage: state.requestEnd();
+ *        if (state.hasEnded()) . . .
+ *        state.resetControl();
+ * ----------------------------------------
+ * END uses requestEnd to stop the running program.  resetControl drops
+ * any pending jump or end request before a new run starts.
+ */
+
+   void requestEnd() { ended = true; }
+   bool hasEnded() { return ended; }
+   void resetControl() { jumping = ended = prompted = false; }
+
+/*
+ * Methods: setSuspendable, isSuspendable, setPrompted, takePrompted
+ * Usage: state.setSuspendable(true);
+ *        if (!state.takePrompted()) . . .
+ * ----------------------------------------------------------------
+ * On a suspendable state, an INPUT statement that finds no complete
+ * line in the reader throws InputPending (see statement.h) instead of
+ * waiting for one, so that the program can be resumed when the line
+ * arrives.  It marks the state with setPrompted first, and takePrompted
+ * tells it on resumption that its prompt has already been printed.
+ */
+
+   void setSuspendable(bool flag) { suspendable = flag; }
+   bool isSuspendable() { return suspendable; }
+   void setPrompted() { prompted = true; }
+   bool takePrompted() { bool was = prompted; prompted = false; return was; }
+
+/*
+ * Methods: setSlice, getSlice, countStatements, getStatementCount
+ * Usage: state.setSlice(10000);
+ *        long long n = state.getStatementCount();
+ * ---------------------------------------------------------------
+ * A run on a state with a slice of n statements is preempted at the
+ * first block boundary or loop iteration after n statements, so that a
+ * scheduler can share a thread between many programs (see
+ * Program::resume).  A slice of 0, the default, never preempts.  The
+ * program counts the statements it runs on the state with
+ * countStatements, and getStatementCount returns the total.
+ */
+
+   void setSlice(long long statements) { slice = statements; }
+   long long getSlice() { return slice; }
+   void countStatements(long long n) { statements += n; }
+   long long getStatementCount() { return statements; }
+
 private:
 
-   Map<std::string,int> symbolTable;
+   struct Slot {
+      int symbol;
+      int value;
+      unsigned generation;
+   };
+
+   static const int PAGE_BITS = 9;
+   static const int PAGE_SLOTS = 1 << PAGE_BITS;
+
+   typedef std::vector<Slot> Page;
+
+   struct Directory {
+      std::vector<std::shared_ptr<Page> > pages;
+      std::vector<Slot *> raw;
+      std::vector<char> owned;
+      std::atomic<bool> shared;
+   };
+
+   std::shared_ptr<Directory> dir;
+   Slot **raw;
+   char *owned;
+   int capacity;
+   unsigned generation;
+   int count;
+   int shift;
+   unsigned long long version;
+   long long cacheHits, cacheMisses;
+   OutputSink *output;
+   LineReader *input;
+   int jumpTarget;
+   bool jumping, ended;
+   bool suspendable, prompted;
+   long long slice, statements;
+
+   int home(int symbol) const {
+      return (int) ((unsigned) symbol * 2654435769u >> shift);
+   }
+
+   const Slot & at(int i) const {
+      return raw[i >> PAGE_BITS][i & (PAGE_SLOTS - 1)];
+   }
+
+   Slot & writable(int i) {
+      int page = i >> PAGE_BITS;
+      if (!owned[page] || dir->shared.load(std::memory_order_relaxed)) unshare(page);
+      return raw[page][i & (PAGE_SLOTS - 1)];
+   }
+
+   int find(int symbol) const;
+   void unshare(int page);
+   void attach(const std::shared_ptr<Directory> & dir);
+   void allocate(int capacity);
+   void grow();
+   void reset();
+   void touch();
 
 };
 
+inline const int *EvalState::lookup(int symbol) {
+   int mask = capacity - 1;
+   for (int i = home(symbol); ; i = (i + 1) & mask) {
+      const Slot &slot = at(i);
+      if (slot.generation != generation) return nullptr;
+      if (slot.symbol == symbol) return &slot.value;
+   }
+}
+
 #endif
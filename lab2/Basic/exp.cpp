@@ -4,6 +4,7 @@
  * This file implements the Expression class and its subclasses.
  */
 
+#include <climits>
 #include <string>
 #include "../StanfordCPPLib/error.h"
 #include "evalstate.h"
@@ -51,6 +52,10 @@ ExpressionType ConstantExp::getType() {
    return CONSTANT;
 }
 
+Expression *ConstantExp::clone() {
+   return new ConstantExp(value);
+}
+
 int ConstantExp::getValue() {
    return value;
 }
@@ -61,15 +66,37 @@ int ConstantExp::getValue() {
  * The IdentifierExp subclass declares a single instance variable that
  * stores the name of the variable.  The implementation of eval must
  * look this variable up in the evaluation state.
+ *
+ * Each identifier also keeps an inline cache: the storage cell found by
+ * its last lookup and the structural version of the state at the time
+ * (see getVersion in evalstate.h).  While the version is unchanged,
+ * eval reads the cell directly and skips the table.  The cache belongs
+ * to the expression, so a tree must be evaluated by one thread at a
+ * time, which the rest of the program already requires.
  */
 
 IdentifierExp::IdentifierExp(string name) {
    this->name = name;
+   this->symbol = internSymbol(name);
+   this->checked = true;
+   this->cell = nullptr;
+   this->cellVersion = 0;
 }
 
 int IdentifierExp::eval(EvalState & state) {
-   if (!state.isDefined(name)) error("VARIABLE NOT DEFINED");
-   return state.getValue(name);
+   if (cellVersion == state.getVersion()) {
+      state.recordCacheHit();
+      return *cell;
+   }
+   state.recordCacheMiss();
+   const int *found = state.lookup(symbol);
+   if (found != nullptr) {
+      cell = found;
+      cellVersion = state.getVersion();
+      return *found;
+   }
+   if (checked) error("VARIABLE NOT DEFINED");
+   return 0;
 }
 
 string IdentifierExp::toString() {
@@ -80,10 +107,36 @@ ExpressionType IdentifierExp::getType() {
    return IDENTIFIER;
 }
 
+IdentifierExp::IdentifierExp(int symbol) {
+   this->name = symbolName(symbol);
+   this->symbol = symbol;
+   this->checked = true;
+   this->cell = nullptr;
+   this->cellVersion = 0;
+}
+
+Expression *IdentifierExp::clone() {
+   IdentifierExp *copy = new IdentifierExp(symbol);
+   copy->checked = checked;
+   return copy;
+}
+
 string IdentifierExp::getName() {
    return name;
 }
 
+int IdentifierExp::getSymbol() {
+   return symbol;
+}
+
+void IdentifierExp::setChecked(bool checked) {
+   this->checked = checked;
+}
+
+bool IdentifierExp::isChecked() {
+   return checked;
+}
+
 /*
  * Implementation notes: the CompoundExp subclass
  * ----------------------------------------------
@@ -94,8 +147,10 @@ string IdentifierExp::getName() {
 
 CompoundExp::CompoundExp(string op, Expression *lhs, Expression *rhs) {
    this->op = op;
+   this->code = op.empty() ? 0 : op[0];
    this->lhs = lhs;
    this->rhs = rhs;
+   this->checked = true;
 }
 
 CompoundExp::~CompoundExp() {
@@ -112,22 +167,26 @@ CompoundExp::~CompoundExp() {
  */
 
 int CompoundExp::eval(EvalState & state) {
-   if (op == "=") {
+   if (code == '=') {
       if (lhs->getType() != IDENTIFIER) {
          error("SYNTAX ERROR");
       }
       int val = rhs->eval(state);
-      state.setValue(((IdentifierExp *) lhs)->getName(), val);
+      state.setValue(((IdentifierExp *) lhs)->getSymbol(), val);
       return val;
    }
    int left = lhs->eval(state);
    int right = rhs->eval(state);
-   if (op == "+") return left + right;
-   if (op == "-") return left - right;
-   if (op == "*") return left * right;
-   if (op == "/") {
-	   if (right == 0) error("DIVIDE BY ZERO");
-	   return left / right;
+   if (code == '/' && checked && right == 0) error("DIVIDE BY ZERO");
+   return apply(left, right);
+}
+
+int CompoundExp::apply(int left, int right) {
+   switch (code) {
+      case '+': return left + right;
+      case '-': return left - right;
+      case '*': return left * right;
+      case '/': return left / right;
    }
    error("SYNTAX ERROR");
    return 0;
@@ -141,6 +200,12 @@ ExpressionType CompoundExp::getType() {
    return COMPOUND;
 }
 
+Expression *CompoundExp::clone() {
+   CompoundExp *copy = new CompoundExp(op, lhs->clone(), rhs->clone());
+   copy->checked = checked;
+   return copy;
+}
+
 string CompoundExp::getOp() {
    return op;
 }
@@ -152,3 +217,128 @@ Expression *CompoundExp::getLHS() {
 Expression *CompoundExp::getRHS() {
    return rhs;
 }
+
+void CompoundExp::setLHS(Expression *lhs) {
+   this->lhs = lhs;
+}
+
+void CompoundExp::setRHS(Expression *rhs) {
+   this->rhs = rhs;
+}
+
+void CompoundExp::setChecked(bool checked) {
+   this->checked = checked;
+}
+
+bool CompoundExp::isChecked() {
+   return checked;
+}
+
+/*
+ * Implementation notes: the ConstDivExp subclass
+ * ----------------------------------------------
+ * The magic numbers follow Warren, Hacker's Delight, chapter 10.  For a
+ * divisor d with |d| >= 2 that is not a power of two, the quotient is
+ * the high half of n * magic, corrected by n when the sign of magic is
+ * wrong and shifted right; adding one when the result is negative turns
+ * the floor into truncation.  Powers of two only need the shift with a
+ * bias for negative n, and INT_MIN is handled as a comparison.
+ */
+
+enum { DIV_IDENTITY, DIV_POW2, DIV_MAGIC, DIV_INT_MIN };
+
+ConstDivExp::ConstDivExp(Expression *lhs, ConstantExp *rhs) : CompoundExp("/", lhs, rhs) {
+   divisor = rhs->getValue();
+   magic = shift = 0;
+   unsigned ad = divisor < 0 ? 0u - (unsigned) divisor : (unsigned) divisor;
+   if (divisor == 1) {
+      kind = DIV_IDENTITY;
+   } else if (divisor == INT_MIN) {
+      kind = DIV_INT_MIN;
+   } else if ((ad & (ad - 1)) == 0) {
+      kind = DIV_POW2;
+      while ((1u << shift) != ad) shift++;
+   } else {
+      kind = DIV_MAGIC;
+      const unsigned two31 = 0x80000000u;
+      unsigned t = two31 + ((unsigned) divisor >> 31);
+      unsigned anc = t - 1 - t % ad;
+      unsigned q1 = two31 / anc, r1 = two31 - q1 * anc;
+      unsigned q2 = two31 / ad, r2 = two31 - q2 * ad;
+      unsigned delta;
+      int p = 31;
+      do {
+         p++;
+         q1 *= 2;
+         r1 *= 2;
+         if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+         }
+         q2 *= 2;
+         r2 *= 2;
+         if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+         }
+         delta = ad - r2;
+      } while (q1 < delta || (q1 == delta && r1 == 0));
+      magic = (int) (q2 + 1);
+      if (divisor < 0) magic = -magic;
+      shift = p - 32;
+   }
+}
+
+int ConstDivExp::eval(EvalState & state) {
+   return apply(getLHS()->eval(state), divisor);
+}
+
+Expression *ConstDivExp::clone() {
+   return new ConstDivExp(getLHS()->clone(), new ConstantExp(divisor));
+}
+
+int ConstDivExp::apply(int left, int) {
+   switch (kind) {
+      case DIV_IDENTITY:
+         return left;
+      case DIV_INT_MIN:
+         return left == INT_MIN ? 1 : 0;
+      case DIV_POW2: {
+         int bias = (int) ((unsigned) (left >> 31) >> (32 - shift));
+         int q = (left + bias) >> shift;
+         return divisor < 0 ? -q : q;
+      }
+   }
+   int q = (int) (((long long) magic * left) >> 32);
+   if (divisor > 0 && magic < 0) q += left;
+   if (divisor < 0 && magic > 0) q -= left;
+   q >>= shift;
+   return q + (int) ((unsigned) q >> 31);
+}
+
+/*
+ * Implementation notes: the RemainderExp subclass
+ * -----------------------------------------------
+ * The original expression evaluates a, a and b, b in that order.  Since
+ * a and b cannot assign, evaluating each of them once gives the same
+ * values and reports the same first error.  The quotient comes from the
+ * division node itself, so a constant divisor still uses its magic
+ * numbers and a check turned off by the optimizer stays off.
+ */
+
+RemainderExp::RemainderExp(Expression *lhs, Expression *rhs) : CompoundExp("-", lhs, rhs) {
+   /* Empty */
+}
+
+int RemainderExp::eval(EvalState & state) {
+   if (getRHS()->getType() != COMPOUND) return CompoundExp::eval(state);
+   CompoundExp *quotient = (CompoundExp *) ((CompoundExp *) getRHS())->getLHS();
+   int a = getLHS()->eval(state);
+   int b = quotient->getRHS()->eval(state);
+   if (quotient->isChecked() && b == 0) error("DIVIDE BY ZERO");
+   return (int) ((unsigned) a - (unsigned) quotient->apply(a, b) * (unsigned) b);
+}
+
+Expression *RemainderExp::clone() {
+   return new RemainderExp(getLHS()->clone(), getRHS()->clone());
+}
@@ -96,6 +96,15 @@ public:
 
    virtual ExpressionType getType() = 0;
 
+/*
+ * Method: clone
+ * Usage: Expression *copy = exp->clone();
+ * ---------------------------------------
+ * Returns a deep copy of this expression, which the caller must free.
+ */
+
+   virtual Expression *clone() = 0;
+
 };
 
 /*
@@ -128,6 +137,7 @@ public:
    virtual int eval(EvalState & state);
    virtual std::string toString();
    virtual ExpressionType getType();
+   virtual Expression *clone();
 
 /*
  * Method: getValue
@@ -165,6 +175,16 @@ public:
 
    IdentifierExp(std::string name);
 
+/*
+ * Constructor: IdentifierExp
+ * Usage: Expression *exp = new IdentifierExp(symbol);
+ * ---------------------------------------------------
+ * Initializes an identifier expression for a symbol that is already
+ * interned, without looking its name up again.
+ */
+
+   IdentifierExp(int symbol);
+
 /*
  * Prototypes for the virtual methods
  * ----------------------------------
@@ -175,6 +195,7 @@ public:
    virtual int eval(EvalState & state);
    virtual std::string toString();
    virtual ExpressionType getType();
+   virtual Expression *clone();
 
 /*
  * Method: getName
@@ -186,9 +207,34 @@ public:
 
    std::string getName();
 
+/*
+ * Method: getSymbol
+ * Usage: int symbol = ((IdentifierExp *) exp)->getSymbol();
+ * ---------------------------------------------------------
+ * Returns the interned symbol id of the name, which the constructor
+ * looks up once so that eval never has to hash the name.
+ */
+
+   int getSymbol();
+
+/*
+ * Methods: setChecked, isChecked
+ * Usage: ((IdentifierExp *) exp)->setChecked(false);
+ * --------------------------------------------------
+ * Turns the VARIABLE NOT DEFINED check off for an identifier that the
+ * optimizer has proved to be defined whenever it is evaluated.
+ */
+
+   void setChecked(bool checked);
+   bool isChecked();
+
 private:
 
    std::string name;
+   int symbol;
+   bool checked;
+   const int *cell;
+   unsigned long long cellVersion;
 
 };
 
@@ -225,6 +271,7 @@ public:
    virtual int eval(EvalState & state);
    virtual std::string toString();
    virtual ExpressionType getType();
+   virtual Expression *clone();
 
 /*
  * Methods: getOp, getLHS, getRHS
@@ -240,10 +287,109 @@ public:
    Expression *getLHS();
    Expression *getRHS();
 
+/*
+ * Methods: setLHS, setRHS
+ * Usage: ((CompoundExp *) exp)->setLHS(lhs);
+ * ------------------------------------------
+ * Replace a subexpression without freeing the old one, which is left to
+ * the caller.  These are used by the optimizer to rewrite the tree.
+ */
+
+   void setLHS(Expression *lhs);
+   void setRHS(Expression *rhs);
+
+/*
+ * Methods: setChecked, isChecked
+ * Usage: ((CompoundExp *) exp)->setChecked(false);
+ * ------------------------------------------------
+ * Turns the DIVIDE BY ZERO check off for a division whose divisor the
+ * optimizer has proved to be nonzero.
+ */
+
+   void setChecked(bool checked);
+   bool isChecked();
+
+/*
+ * Method: apply
+ * Usage: int value = ((CompoundExp *) exp)->apply(left, right);
+ * -------------------------------------------------------------
+ * Applies the arithmetic operator to two values that have already been
+ * evaluated, without any check.  Subclasses that specialize an operator
+ * override this method.
+ */
+
+   virtual int apply(int left, int right);
+
 private:
 
    std::string op;
+   char code;
    Expression *lhs, *rhs;
+   bool checked;
+
+};
+
+/*
+ * Class: ConstDivExp
+ * ------------------
+ * This subclass represents the division of an expression by a constant
+ * other than 0 and -1.  The division is done with a multiplication and
+ * shifts by magic numbers computed when the node is created, and gives
+ * the same truncated result as the / operator.
+ */
+
+class ConstDivExp: public CompoundExp {
+
+public:
+
+/*
+ * Constructor: ConstDivExp
+ * Usage: Expression *exp = new ConstDivExp(lhs, rhs);
+ * ---------------------------------------------------
+ * Creates the node for lhs / rhs, where rhs must be a ConstantExp whose
+ * value is neither 0 nor -1.
+ */
+
+   ConstDivExp(Expression *lhs, ConstantExp *rhs);
+
+   virtual int eval(EvalState & state);
+   virtual Expression *clone();
+   virtual int apply(int left, int right);
+
+private:
+
+   int divisor;
+   int magic;
+   int shift;
+   int kind;
+
+};
+
+/*
+ * Class: RemainderExp
+ * -------------------
+ * This subclass represents the expression a - a / b * b, which BASIC
+ * programs use for the remainder.  The tree keeps its original shape,
+ * so it prints and analyses like any other subtraction, but eval
+ * computes it with a single division.  a and b must not assign.
+ */
+
+class RemainderExp: public CompoundExp {
+
+public:
+
+/*
+ * Constructor: RemainderExp
+ * Usage: Expression *exp = new RemainderExp(a, product);
+ * ------------------------------------------------------
+ * Creates the node for a - product, where product is the CompoundExp
+ * for a / b * b.
+ */
+
+   RemainderExp(Expression *lhs, Expression *rhs);
+
+   virtual int eval(EvalState & state);
+   virtual Expression *clone();
 
 };
 
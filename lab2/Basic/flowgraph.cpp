@@ -0,0 +1,275 @@
+/*
+ * File: flowgraph.cpp
+ * -------------------
+ * This file implements the flowgraph.h interface.
+ */
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "flowgraph.h"
+using namespace std;
+
+ControlFlowGraph::ControlFlowGraph(const vector<SourceLine> &lines) {
+	buildBlocks(lines);
+	computeOrder();
+	computeDominators();
+	computeLoops();
+}
+
+ControlFlowGraph::~ControlFlowGraph() {
+	for (size_t i = 0; i < blocks.size(); i++) {
+		delete blocks[i]->counted;
+		delete blocks[i];
+	}
+	for (size_t i = 0; i < loops.size(); i++) delete loops[i];
+}
+
+BasicBlock *ControlFlowGraph::getEntry() {
+	return blocks.empty() ? nullptr : blocks[0];
+}
+
+BasicBlock *ControlFlowGraph::findBlock(int lineNumber) {
+	auto it = leaders.find(lineNumber);
+	return it == leaders.end() ? nullptr : it->second;
+}
+
+const vector<BasicBlock *> &ControlFlowGraph::getBlocks() {
+	return blocks;
+}
+
+const vector<BasicBlock *> &ControlFlowGraph::getReversePostorder() {
+	return rpo;
+}
+
+const vector<Loop *> &ControlFlowGraph::getLoops() {
+	return loops;
+}
+
+bool ControlFlowGraph::dominates(BasicBlock *a, BasicBlock *b) {
+	if (a->order < 0 || b->order < 0) return false;
+	while (b != nullptr && b->order > a->order) b = b->idom;
+	return b == a;
+}
+
+/*
+ * Implementation notes: buildBlocks
+ * ---------------------------------
+ * A line starts a new block if it is the first line, the target of some
+ * GOTO or IF, or the line after a GOTO, IF or END.  Jumps to lines that
+ * do not exist get a nullptr edge; the program reports the error only if
+ * the jump is actually taken.
+ */
+
+static bool isTerminator(Statement *stmt) {
+	if (stmt == nullptr) return false;
+	StatementType type = stmt->getType();
+	return type == GOTO_STATEMENT || type == IF_STATEMENT || type == END_STATEMENT;
+}
+
+static int jumpTarget(Statement *stmt) {
+	if (stmt->getType() == GOTO_STATEMENT) return ((GOTO_Sta *) stmt)->getLineNumber();
+	if (stmt->getType() == IF_STATEMENT) return ((IF_Sta *) stmt)->getLineNumber();
+	return -1;
+}
+
+void ControlFlowGraph::buildBlocks(const vector<SourceLine> &lines) {
+	map<int, bool> targets;
+	for (size_t i = 0; i < lines.size(); i++) {
+		if (isTerminator(lines[i].stmt) && lines[i].stmt->getType() != END_STATEMENT)
+			targets[jumpTarget(lines[i].stmt)] = true;
+	}
+	BasicBlock *current = nullptr;
+	for (size_t i = 0; i < lines.size(); i++) {
+		int lineNumber = lines[i].lineNumber;
+		if (current == nullptr || current->terminator != nullptr || targets.count(lineNumber)) {
+			current = new BasicBlock;
+			current->index = blocks.size();
+			current->firstLine = lineNumber;
+			current->terminator = nullptr;
+			current->jumpLine = -1;
+			current->next = current->jump = current->idom = nullptr;
+			current->order = -1;
+			current->loopDepth = 0;
+			current->loop = nullptr;
+			current->counted = nullptr;
+			blocks.push_back(current);
+			leaders[lineNumber] = current;
+		}
+		current->lastLine = lineNumber;
+		Statement *stmt = lines[i].stmt;
+		if (stmt == nullptr) continue;
+		current->stmts.push_back(stmt);
+		if (isTerminator(stmt)) {
+			current->terminator = stmt;
+			current->jumpLine = jumpTarget(stmt);
+		}
+	}
+	for (size_t i = 0; i < blocks.size(); i++) {
+		BasicBlock *block = blocks[i];
+		BasicBlock *following = i + 1 < blocks.size() ? blocks[i + 1] : nullptr;
+		StatementType type = block->terminator ? block->terminator->getType() : LET_STATEMENT;
+		if (block->terminator == nullptr || type == IF_STATEMENT) block->next = following;
+		if (block->jumpLine >= 0) block->jump = findBlock(block->jumpLine);
+		if (block->next != nullptr) block->succs.push_back(block->next);
+		if (block->jump != nullptr && block->jump != block->next) block->succs.push_back(block->jump);
+		for (size_t j = 0; j < block->succs.size(); j++)
+			block->succs[j]->preds.push_back(block);
+	}
+}
+
+/*
+ * Implementation notes: computeOrder
+ * ----------------------------------
+ * The depth-first search uses an explicit stack so that very long
+ * programs cannot overflow the call stack.
+ */
+
+void ControlFlowGraph::computeOrder() {
+	if (blocks.empty()) return;
+	vector<BasicBlock *> post;
+	vector<bool> visited(blocks.size(), false);
+	vector<pair<BasicBlock *, size_t> > stack;
+	stack.push_back(make_pair(blocks[0], (size_t) 0));
+	visited[0] = true;
+	while (!stack.empty()) {
+		BasicBlock *block = stack.back().first;
+		size_t &child = stack.back().second;
+		if (child < block->succs.size()) {
+			BasicBlock *succ = block->succs[child++];
+			if (!visited[succ->index]) {
+				visited[succ->index] = true;
+				stack.push_back(make_pair(succ, (size_t) 0));
+			}
+		} else {
+			post.push_back(block);
+			stack.pop_back();
+		}
+	}
+	rpo.assign(post.rbegin(), post.rend());
+	for (size_t i = 0; i < rpo.size(); i++) rpo[i]->order = i;
+}
+
+/*
+ * Implementation notes: computeDominators
+ * ---------------------------------------
+ * This is the iterative algorithm of Cooper, Harvey and Kennedy, which
+ * walks up the partially built tree from two predecessors until the
+ * paths meet.  Blocks are compared by their reverse postorder number.
+ */
+
+static BasicBlock *intersect(BasicBlock *a, BasicBlock *b) {
+	while (a != b) {
+		while (a->order > b->order) a = a->idom;
+		while (b->order > a->order) b = b->idom;
+	}
+	return a;
+}
+
+void ControlFlowGraph::computeDominators() {
+	if (rpo.empty()) return;
+	BasicBlock *entry = rpo[0];
+	entry->idom = entry;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t i = 1; i < rpo.size(); i++) {
+			BasicBlock *block = rpo[i];
+			BasicBlock *idom = nullptr;
+			for (size_t j = 0; j < block->preds.size(); j++) {
+				BasicBlock *pred = block->preds[j];
+				if (pred->idom == nullptr) continue;
+				idom = idom == nullptr ? pred : intersect(pred, idom);
+			}
+			if (idom != block->idom) {
+				block->idom = idom;
+				changed = true;
+			}
+		}
+	}
+	entry->idom = nullptr;
+}
+
+/*
+ * Implementation notes: computeLoops
+ * ----------------------------------
+ * An edge whose target dominates its source is a back edge.  The body
+ * of the loop is found by walking predecessors back from each latch to
+ * the header.  Sorting the loops by size puts every inner loop before
+ * the loops that contain it, so the first loop found for a block is the
+ * innermost one.
+ */
+
+static bool loopContains(Loop *loop, BasicBlock *block) {
+	return binary_search(loop->blocks.begin(), loop->blocks.end(), block,
+	                     [](BasicBlock *a, BasicBlock *b) { return a->index < b->index; });
+}
+
+static bool bySize(Loop *a, Loop *b) {
+	if (a->blocks.size() != b->blocks.size()) return a->blocks.size() < b->blocks.size();
+	return a->header->index < b->header->index;
+}
+
+static int loopDepth(Loop *loop) {
+	if (loop->depth == 0) loop->depth = loop->parent ? loopDepth(loop->parent) + 1 : 1;
+	return loop->depth;
+}
+
+void ControlFlowGraph::computeLoops() {
+	map<BasicBlock *, Loop *> byHeader;
+	for (size_t i = 0; i < rpo.size(); i++) {
+		BasicBlock *latch = rpo[i];
+		for (size_t j = 0; j < latch->succs.size(); j++) {
+			BasicBlock *header = latch->succs[j];
+			if (!dominates(header, latch)) continue;
+			Loop *&loop = byHeader[header];
+			if (loop == nullptr) {
+				loop = new Loop;
+				loop->header = header;
+				loop->parent = nullptr;
+				loop->depth = 0;
+				loops.push_back(loop);
+			}
+			loop->latches.push_back(latch);
+		}
+	}
+	vector<size_t> mark(blocks.size(), 0);
+	for (size_t i = 0; i < loops.size(); i++) {
+		Loop *loop = loops[i];
+		vector<BasicBlock *> work(loop->latches.begin(), loop->latches.end());
+		mark[loop->header->index] = i + 1;
+		loop->blocks.push_back(loop->header);
+		while (!work.empty()) {
+			BasicBlock *block = work.back();
+			work.pop_back();
+			if (mark[block->index] == i + 1) continue;
+			mark[block->index] = i + 1;
+			loop->blocks.push_back(block);
+			for (size_t j = 0; j < block->preds.size(); j++) {
+				if (block->preds[j]->order >= 0) work.push_back(block->preds[j]);
+			}
+		}
+		sort(loop->blocks.begin(), loop->blocks.end(),
+		     [](BasicBlock *a, BasicBlock *b) { return a->index < b->index; });
+	}
+	sort(loops.begin(), loops.end(), bySize);
+	for (size_t i = 0; i < loops.size(); i++) {
+		for (size_t j = i + 1; j < loops.size(); j++) {
+			if (loopContains(loops[j], loops[i]->header)) {
+				loops[i]->parent = loops[j];
+				break;
+			}
+		}
+	}
+	for (size_t i = 0; i < loops.size(); i++) {
+		Loop *loop = loops[i];
+		int depth = loopDepth(loop);
+		for (size_t j = 0; j < loop->blocks.size(); j++) {
+			BasicBlock *block = loop->blocks[j];
+			if (block->loop == nullptr) {
+				block->loop = loop;
+				block->loopDepth = depth;
+			}
+		}
+	}
+}
@@ -0,0 +1,197 @@
+/*
+ * File: flowgraph.h
+ * -----------------
+ * This interface exports the ControlFlowGraph class, which splits the
+ * lines of a BASIC program into basic blocks and records how control
+ * moves between them.  The graph is the structure the program uses to
+ * run a block at a time and the one the program analyses work on.
+ */
+
+#ifndef _flowgraph_h
+#define _flowgraph_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include "statement.h"
+
+/*
+ * Type: SourceLine
+ * ----------------
+ * A line of the program as seen by the graph builder: the line number
+ * and the parsed statement, which is nullptr for REM lines.
+ */
+
+struct SourceLine {
+   int lineNumber;
+   Statement *stmt;
+};
+
+struct Loop;
+struct CountedLoop;
+
+/*
+ * Type: BasicBlock
+ * ----------------
+ * A maximal run of lines that is entered only at its first line and
+ * left only after its last one.  A block ends after every GOTO, IF and
+ * END statement and before every line that is the target of a jump.
+ *
+ * The terminator is the GOTO, IF or END statement that ends the block,
+ * or nullptr if the block simply falls into the next one.  next is the
+ * fall-through successor and jump the block at jumpLine; either may be
+ * nullptr, which means the program ends or, for a jump, that the target
+ * line does not exist.  counted is set by the optimizer on a block that
+ * is a whole counted loop by itself.
+ */
+
+struct BasicBlock {
+   int index;
+   int firstLine, lastLine;
+   std::vector<Statement *> stmts;
+   Statement *terminator;
+   int jumpLine;
+   BasicBlock *next;
+   BasicBlock *jump;
+   std::vector<BasicBlock *> preds, succs;
+   BasicBlock *idom;
+   int order;
+   int loopDepth;
+   Loop *loop;
+   CountedLoop *counted;
+};
+
+/*
+ * Type: Loop
+ * ----------
+ * A natural loop: the header, which dominates every block in the loop,
+ * the latches whose back edges return to the header, and the enclosing
+ * loop, if any.  blocks includes the header and is sorted by index.
+ */
+
+struct Loop {
+   BasicBlock *header;
+   std::vector<BasicBlock *> latches;
+   std::vector<BasicBlock *> blocks;
+   Loop *parent;
+   int depth;
+};
+
+/*
+ * Type: CountedLoop
+ * -----------------
+ * A block that jumps back to itself and ends with
+ *
+ *    LET var = var + step
+ *    IF var op bound THEN <the block>
+ *
+ * where step is a constant.  symbol is the interned id of var and op is
+ * the comparison with var on the left.
+ * varWritten is true if the statements before the increment assign var,
+ * and boundInvariant is true if nothing in the block changes the value
+ * of bound, so that it only needs to be evaluated once per entry.
+ */
+
+struct CountedLoop {
+   std::string var;
+   int symbol;
+   int step;
+   char op;
+   Expression *bound;
+   bool varWritten;
+   bool boundInvariant;
+};
+
+/*
+ * Class: ControlFlowGraph
+ * -----------------------
+ * This class builds the basic blocks of a program together with the
+ * fall-through and jump edges between them, the dominator tree and the
+ * loop nesting forest.  The graph refers to the statements passed to
+ * the constructor but does not own them.
+ */
+
+class ControlFlowGraph {
+
+public:
+
+/*
+ * Constructor: ControlFlowGraph
+ * Usage: ControlFlowGraph graph(lines);
+ * -------------------------------------
+ * Builds the graph for the given lines, which must be sorted by line
+ * number.
+ */
+
+   ControlFlowGraph(const std::vector<SourceLine> &lines);
+
+/*
+ * Destructor: ~ControlFlowGraph
+ * Usage: usually implicit
+ * -----------------------
+ * Frees the blocks and loops, but not the statements they refer to.
+ */
+
+   ~ControlFlowGraph();
+
+/*
+ * Method: getEntry
+ * Usage: BasicBlock *block = graph.getEntry();
+ * --------------------------------------------
+ * Returns the block holding the first line, or nullptr for an empty
+ * program.
+ */
+
+   BasicBlock *getEntry();
+
+/*
+ * Method: findBlock
+ * Usage: BasicBlock *block = graph.findBlock(lineNumber);
+ * -------------------------------------------------------
+ * Returns the block that starts at the given line, or nullptr if no
+ * block starts there.
+ */
+
+   BasicBlock *findBlock(int lineNumber);
+
+/*
+ * Methods: getBlocks, getReversePostorder, getLoops
+ * Usage: for (BasicBlock *block : graph.getBlocks()) . . .
+ * --------------------------------------------------------
+ * getBlocks returns every block in line order, getReversePostorder only
+ * the blocks reachable from the entry in reverse postorder, and getLoops
+ * the natural loops with every inner loop listed before its parent.
+ */
+
+   const std::vector<BasicBlock *> &getBlocks();
+   const std::vector<BasicBlock *> &getReversePostorder();
+   const std::vector<Loop *> &getLoops();
+
+/*
+ * Method: dominates
+ * Usage: if (graph.dominates(a, b)) . . .
+ * ---------------------------------------
+ * Returns true if every path from the entry to b passes through a.
+ * Unreachable blocks are dominated by nothing.
+ */
+
+   bool dominates(BasicBlock *a, BasicBlock *b);
+
+private:
+
+   std::vector<BasicBlock *> blocks;
+   std::vector<BasicBlock *> rpo;
+   std::vector<Loop *> loops;
+   std::map<int, BasicBlock *> leaders;
+
+   void buildBlocks(const std::vector<SourceLine> &lines);
+   void computeOrder();
+   void computeDominators();
+   void computeLoops();
+
+   ControlFlowGraph(const ControlFlowGraph &);
+   ControlFlowGraph &operator=(const ControlFlowGraph &);
+
+};
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ * File: image.cpp
+ * ---------------
+ * This file implements the image.h interface.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+#include "image.h"
+#include "parser.h"
+#include "../StanfordCPPLib/error.h"
+#include "../StanfordCPPLib/strlib.h"
+using namespace std;
+
+static const char MAGIC[8] = { 'B', 'A', 'S', 'I', 'C', 'I', 'M', 'G' };
+
+/*
+ * Implementation notes: tags
+ * --------------------------
+ * A statement starts with NO_STATEMENT for a REM line or with 1 plus
+ * its StatementType.  An expression starts with 'C' for a constant,
+ * 'I' for an identifier or the character of its operator.  The left
+ * operand of = is read back as it was written even if it is not a
+ * variable, since the parser accepts that and reports it only when the
+ * assignment runs.
+ */
+
+static const int NO_STATEMENT = 0;
+
+bool isProgramImage(const char *data, size_t size) {
+   return size >= sizeof MAGIC && memcmp(data, MAGIC, sizeof MAGIC) == 0;
+}
+
+ImageWriter::ImageWriter() {
+   lineCount = 0;
+}
+
+void ImageWriter::addLine(int lineNumber, const string & text, Statement *stmt) {
+   putInt(lines, lineNumber);
+   putInt(lines, text.length());
+   lines.insert(lines.end(), text.begin(), text.end());
+   putStatement(stmt);
+   lineCount++;
+}
+
+/*
+ * Implementation notes: save
+ * --------------------------
+ * The image is written to a temporary file next to the target and then
+ * renamed over it, so that no reader sees half an image.  The temporary
+ * name carries the process id and a counter, so that saves running at
+ * the same time, from different processes or from different sessions
+ * of one server, never share a file.
+ */
+
+static atomic<int> saveCounter(0);
+
+void ImageWriter::save(const string & filename) {
+   vector<char> header(MAGIC, MAGIC + sizeof MAGIC);
+   putInt(header, IMAGE_VERSION);
+   putInt(header, symbols.size());
+   putInt(header, lineCount);
+   for (size_t i = 0; i < symbols.size(); i++) {
+      const string & name = symbolName(symbols[i]);
+      putInt(header, name.length());
+      header.insert(header.end(), name.begin(), name.end());
+   }
+   string temp = filename + "." + integerToString(getpid()) + "."
+                 + integerToString(++saveCounter) + ".tmp";
+   ofstream out(temp.c_str(), ios::binary | ios::trunc);
+   out.write(&header[0], header.size());
+   if (!lines.empty()) out.write(&lines[0], lines.size());
+   out.close();
+   if (out.fail()) {
+      remove(temp.c_str());
+      error("Can't write " + filename);
+   }
+#ifdef _WIN32
+   remove(filename.c_str());
+#endif
+   if (rename(temp.c_str(), filename.c_str()) != 0) {
+      remove(temp.c_str());
+      error("Can't write " + filename);
+   }
+}
+
+void ImageWriter::putInt(vector<char> & out, int value) {
+   unsigned bits = value;
+   for (int i = 0; i < 4; i++) out.push_back((char) (bits >> (8 * i)));
+}
+
+/*
+ * Implementation notes: putSymbol
+ * -------------------------------
+ * slots maps the symbol ids of this process to their index in the
+ * image plus one, so that 0 marks a symbol that has not been seen yet.
+ */
+
+void ImageWriter::putSymbol(int symbol) {
+   if ((size_t) symbol >= slots.size()) slots.resize(symbol + 1, 0);
+   if (slots[symbol] == 0) {
+      symbols.push_back(symbol);
+      slots[symbol] = symbols.size();
+   }
+   putInt(lines, slots[symbol] - 1);
+}
+
+void ImageWriter::putStatement(Statement *stmt) {
+   if (stmt == nullptr) {
+      lines.push_back(NO_STATEMENT);
+      return;
+   }
+   StatementType type = stmt->getType();
+   lines.push_back(1 + type);
+   switch (type) {
+    case LET_STATEMENT:
+      putSymbol(internSymbol(((LET_Sta *) stmt)->getVarName()));
+      putExpression(((LET_Sta *) stmt)->getExp());
+      break;
+    case PRINT_STATEMENT:
+      putExpression(((PRINT_Sta *) stmt)->getExp());
+      break;
+    case INPUT_STATEMENT:
+      putSymbol(internSymbol(((INPUT_Sta *) stmt)->getVarName()));
+      break;
+    case END_STATEMENT:
+      break;
+    case GOTO_STATEMENT:
+      putInt(lines, ((GOTO_Sta *) stmt)->getLineNumber());
+      break;
+    case IF_STATEMENT: {
+      IF_Sta *test = (IF_Sta *) stmt;
+      lines.push_back(test->getOp());
+      putExpression(test->getLHS());
+      putExpression(test->getRHS());
+      putInt(lines, test->getLineNumber());
+      break;
+    }
+   }
+}
+
+void ImageWriter::putExpression(Expression *exp) {
+   switch (exp->getType()) {
+    case CONSTANT:
+      lines.push_back('C');
+      putInt(lines, ((ConstantExp *) exp)->getValue());
+      break;
+    case IDENTIFIER:
+      lines.push_back('I');
+      putSymbol(((IdentifierExp *) exp)->getSymbol());
+      break;
+    case COMPOUND: {
+      CompoundExp *compound = (CompoundExp *) exp;
+      lines.push_back(compound->getOp()[0]);
+      putExpression(compound->getLHS());
+      putExpression(compound->getRHS());
+      break;
+    }
+   }
+}
+
+/*
+ * Implementation notes: ImageReader
+ * ---------------------------------
+ * Every read checks the bounds of the image and every tag and symbol
+ * index is checked before it is used, so a damaged image is reported
+ * instead of crashing.  Divisions and the remainder idiom go through
+ * makeCompound, so they get the same nodes as they do when parsed.
+ */
+
+ImageReader::ImageReader(const string & filename) : file(filename) {
+   this->filename = filename;
+   cursor = file.getData();
+   end = cursor + file.getSize();
+   if (!isProgramImage(cursor, file.getSize())) damaged();
+   cursor += sizeof MAGIC;
+   if (readInt() != IMAGE_VERSION) {
+      error("Wrong program image version: " + filename);
+   }
+   int symbolCount = readInt();
+   linesLeft = readInt();
+   if (symbolCount < 0 || linesLeft < 0) damaged();
+   for (int i = 0; i < symbolCount; i++) {
+      int length = readInt();
+      if (length <= 0 || length > end - cursor) damaged();
+      symbols.push_back(internSymbol(string(cursor, length)));
+      cursor += length;
+   }
+}
+
+bool ImageReader::nextLine(int & lineNumber, string & text, Statement *& stmt) {
+   if (linesLeft == 0) {
+      if (cursor != end) damaged();
+      return false;
+   }
+   linesLeft--;
+   lineNumber = readInt();
+   int length = readInt();
+   if (length < 0 || length > end - cursor) damaged();
+   text.assign(cursor, length);
+   cursor += length;
+   stmt = readStatement();
+   return true;
+}
+
+void ImageReader::damaged() {
+   error("Bad program image: " + filename);
+}
+
+int ImageReader::readInt() {
+   if (end - cursor < 4) damaged();
+   unsigned bits = 0;
+   for (int i = 0; i < 4; i++) bits |= (unsigned) (unsigned char) cursor[i] << (8 * i);
+   cursor += 4;
+   return (int) bits;
+}
+
+int ImageReader::readByte() {
+   if (cursor == end) damaged();
+   return (unsigned char) *cursor++;
+}
+
+int ImageReader::readSymbol() {
+   int index = readInt();
+   if (index < 0 || (size_t) index >= symbols.size()) damaged();
+   return symbols[index];
+}
+
+Statement *ImageReader::readStatement() {
+   int tag = readByte();
+   if (tag == NO_STATEMENT) return nullptr;
+   switch (tag - 1) {
+    case LET_STATEMENT: {
+      int symbol = readSymbol();
+      return new LET_Sta(symbolName(symbol), readExpression());
+    }
+    case PRINT_STATEMENT:
+      return new PRINT_Sta(readExpression());
+    case INPUT_STATEMENT:
+      return new INPUT_Sta(symbolName(readSymbol()));
+    case END_STATEMENT:
+      return new END_Sta;
+    case GOTO_STATEMENT:
+      return new GOTO_Sta(readInt());
+    case IF_STATEMENT: {
+      char op = readByte();
+      if (op != '=' && op != '<' && op != '>') damaged();
+      Expression *lhs = readExpression();
+      Expression *rhs = nullptr;
+      try {
+         rhs = readExpression();
+         int lineNumber = readInt();
+         return new IF_Sta(op, lhs, rhs, lineNumber);
+      } catch (...) {
+         delete lhs;
+         delete rhs;
+         throw;
+      }
+    }
+   }
+   damaged();
+   return nullptr;
+}
+
+Expression *ImageReader::readExpression() {
+   int tag = readByte();
+   if (tag == 'C') return new ConstantExp(readInt());
+   if (tag == 'I') return new IdentifierExp(readSymbol());
+   if (tag != '+' && tag != '-' && tag != '*' && tag != '/' && tag != '=') damaged();
+   Expression *lhs = readExpression();
+   Expression *rhs = nullptr;
+   try {
+      rhs = readExpression();
+   } catch (...) {
+      delete lhs;
+      throw;
+   }
+   return makeCompound(string(1, (char) tag), lhs, rhs);
+}
@@ -0,0 +1,152 @@
+/*
+ * File: image.h
+ * -------------
+ * This interface exports the ImageWriter and ImageReader classes, which
+ * store parsed program lines in a binary program image and read them
+ * back without scanning or parsing the source again.
+ */
+
+#ifndef _image_h
+#define _image_h
+
+#include <string>
+#include <vector>
+#include "mapfile.h"
+#include "statement.h"
+
+/*
+ * Constant: IMAGE_VERSION
+ * -----------------------
+ * The version of the image format.  It must be increased whenever the
+ * format changes; a reader rejects an image with any other version.
+ */
+
+const int IMAGE_VERSION = 1;
+
+/*
+ * Function: isProgramImage
+ * Usage: if (isProgramImage(data, size)) . . .
+ * --------------------------------------------
+ * Returns true if the data starts like a program image of any version.
+ */
+
+bool isProgramImage(const char *data, size_t size);
+
+/*
+ * Class: ImageWriter
+ * ------------------
+ * An ImageWriter collects program lines and writes them out as an
+ * image, which holds
+ *
+ *    the header: the 8 bytes "BASICIMG", the version, the number of
+ *                symbols and the number of lines;
+ *    the symbol table: the length and the characters of every name;
+ *    the lines: the line number, the length and the characters of the
+ *               source text and the statement tree in prefix order.
+ *
+ * Every number is a 32-bit little-endian integer, except the tags of
+ * the statements and expressions, which are single bytes.  A variable
+ * is stored as its index in the symbol table of the image.
+ */
+
+class ImageWriter {
+
+public:
+
+/*
+ * Constructor: ImageWriter
+ * Usage: ImageWriter writer;
+ * --------------------------
+ * Creates a writer with no lines.
+ */
+
+   ImageWriter();
+
+/*
+ * Method: addLine
+ * Usage: writer.addLine(lineNumber, text, stmt);
+ * ----------------------------------------------
+ * Adds a program line.  stmt is nullptr for a REM line.  The lines
+ * must be added in increasing order of line number.
+ */
+
+   void addLine(int lineNumber, const std::string & text, Statement *stmt);
+
+/*
+ * Method: save
+ * Usage: writer.save(filename);
+ * -----------------------------
+ * Writes the image to the named file, calling error if it cannot be
+ * written.  The image is written to a temporary file named after the
+ * process and renamed at the end, so the file never holds a partial
+ * image, even when several processes save it at once.
+ */
+
+   void save(const std::string & filename);
+
+private:
+
+   std::vector<char> lines;
+   std::vector<int> symbols;
+   std::vector<int> slots;
+   int lineCount;
+
+   void putInt(std::vector<char> & out, int value);
+   void putSymbol(int symbol);
+   void putStatement(Statement *stmt);
+   void putExpression(Expression *exp);
+
+};
+
+/*
+ * Class: ImageReader
+ * ------------------
+ * An ImageReader maps an image and hands out its lines one at a time.
+ * The symbol table of the image is interned once when the reader is
+ * created, so the statements are built without looking any name up.
+ */
+
+class ImageReader {
+
+public:
+
+/*
+ * Constructor: ImageReader
+ * Usage: ImageReader reader(filename);
+ * ------------------------------------
+ * Maps the named image and checks its header, calling error if the
+ * file cannot be read or is not an image of the current version.
+ */
+
+   ImageReader(const std::string & filename);
+
+/*
+ * Method: nextLine
+ * Usage: while (reader.nextLine(lineNumber, text, stmt)) . . .
+ * ------------------------------------------------------------
+ * Reads the next line and returns true, or returns false after the
+ * last one.  The caller owns the statement.  If the image turns out to
+ * be damaged, nextLine frees what it has built and calls error.
+ */
+
+   bool nextLine(int & lineNumber, std::string & text, Statement *& stmt);
+
+private:
+
+   MappedFile file;
+   std::string filename;
+   const char *cursor;
+   const char *end;
+   std::vector<int> symbols;
+   int linesLeft;
+
+   void damaged();
+   int readInt();
+   int readByte();
+   int readSymbol();
+   Statement *readStatement();
+   Expression *readExpression();
+
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * File: input.cpp
+ * ---------------
+ * This file implements the input.h interface.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "input.h"
+using namespace std;
+
+LineReader::LineReader(int fd, int blockSize) : buffer(blockSize) {
+   this->fd = fd;
+   this->blockSize = blockSize;
+   start = end = 0;
+   eof = false;
+}
+
+LineReader::LineReader(const string & text) : buffer(text.begin(), text.end()) {
+   fd = -1;
+   blockSize = 0;
+   start = 0;
+   end = text.length();
+   eof = true;
+   if (buffer.empty()) buffer.resize(1);
+}
+
+/*
+ * Implementation notes: readLine
+ * ------------------------------
+ * The unread text is buffer[start, end).  When it holds no newline, the
+ * partial line is moved to the front of the buffer and another block
+ * is read behind it; the buffer only grows for a line longer than what
+ * is left of it.
+ */
+
+bool LineReader::readLine(const char *&data, size_t &length) {
+   size_t scanned = start;
+   while (true) {
+      const char *newline = (const char *) memchr(&buffer[0] + scanned, '\n', end - scanned);
+      if (newline != nullptr) {
+         data = &buffer[0] + start;
+         length = newline - data;
+         start += length + 1;
+         return true;
+      }
+      size_t offset = end - start;
+      if (!fill()) break;
+      scanned = start + offset;
+   }
+   if (start == end) return false;
+   data = &buffer[0] + start;
+   length = end - start;
+   start = end;
+   return true;
+}
+
+bool LineReader::readLine(string & line) {
+   const char *data;
+   size_t length;
+   if (!readLine(data, length)) return false;
+   line.assign(data, length);
+   return true;
+}
+
+bool LineReader::atEnd() {
+   while (start == end) {
+      if (!fill()) return true;
+   }
+   return false;
+}
+
+bool LineReader::receive() {
+   return fill();
+}
+
+bool LineReader::hasLine() {
+   if (eof && start < end) return true;
+   return memchr(&buffer[0] + start, '\n', end - start) != nullptr;
+}
+
+bool LineReader::isClosed() {
+   return eof && start == end;
+}
+
+/*
+ * Implementation notes: fill
+ * --------------------------
+ * Moves the unread text to the front of the buffer and reads one more
+ * block after it, returning false once the descriptor reports the end
+ * of the input or an error.  The caller must allow for the move.  A
+ * non-blocking descriptor with nothing to read also returns false, but
+ * leaves the input open.
+ */
+
+bool LineReader::fill() {
+   if (eof) return false;
+   size_t unread = end - start;
+   if (start > 0) {
+      memmove(&buffer[0], &buffer[0] + start, unread);
+      start = 0;
+      end = unread;
+   }
+   if (end == buffer.size() || buffer.size() - end < (size_t) blockSize / 2) {
+      buffer.resize(buffer.size() * 2);
+   }
+   while (true) {
+#ifdef _WIN32
+      int n = _read(fd, &buffer[0] + end, (unsigned) (buffer.size() - end));
+#else
+      ssize_t n = ::read(fd, &buffer[0] + end, buffer.size() - end);
+#endif
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+      if (n <= 0) {
+         eof = true;
+         return false;
+      }
+      end += n;
+      return true;
+   }
+}
+
+LineReader & standardInput() {
+   static LineReader input(0);
+   return input;
+}
@@ -0,0 +1,120 @@
+/*
+ * File: input.h
+ * -------------
+ * This interface exports the LineReader class, which reads the input of
+ * the interpreter in large blocks and splits it into lines.
+ */
+
+#ifndef _input_h
+#define _input_h
+
+#include <string>
+#include <vector>
+
+/*
+ * Class: LineReader
+ * -----------------
+ * A LineReader reads from a file descriptor a block at a time and hands
+ * out the lines it finds in its buffer, so that a line costs a search
+ * for the newline rather than a trip through iostream.  Lines are split
+ * exactly as getline splits them: the newline is dropped, any other
+ * character is kept, and a last line without a newline still counts.
+ *
+ * The command loop and INPUT read from the same reader, so that a
+ * program that reads its data from the same stream as its commands
+ * sees the lines in order.
+ */
+
+class LineReader {
+
+public:
+
+/*
+ * Constructor: LineReader
+ * Usage: LineReader reader(fd);
+ *        LineReader reader(fd, blockSize);
+ * ----------------------------------------
+ * Creates a reader for the file descriptor fd that reads blockSize
+ * bytes at a time.
+ */
+
+   LineReader(int fd, int blockSize = 65536);
+
+/*
+ * Constructor: LineReader
+ * Usage: LineReader reader(text);
+ * -------------------------------
+ * Creates a reader that reads the lines of a copy of text.
+ */
+
+   explicit LineReader(const std::string & text);
+
+/*
+ * Method: readLine
+ * Usage: if (reader.readLine(data, length)) . . .
+ *        if (reader.readLine(line)) . . .
+ * -----------------------------------------------
+ * Reads the next line and returns true, or returns false at the end of
+ * the input.  The first form sets data and length to the line inside
+ * the reader's buffer, which stays valid until the next call, without
+ * copying it.  The second form copies the line into line, reusing its
+ * storage.
+ */
+
+   bool readLine(const char *&data, size_t &length);
+   bool readLine(std::string & line);
+
+/*
+ * Method: atEnd
+ * Usage: if (reader.atEnd()) . . .
+ * --------------------------------
+ * Returns true if every line has been read.  This may read ahead to
+ * find out.
+ */
+
+   bool atEnd();
+
+/*
+ * Methods: receive, hasLine, isClosed
+ * Usage: if (reader.receive()) . . .
+ *        while (reader.hasLine()) . . .
+ *        if (reader.isClosed()) . . .
+ * ------------------------------------
+ * These let a server read from a connection without waiting for whole
+ * lines.  receive makes one read from the descriptor, which waits only
+ * if nothing has arrived and the descriptor is blocking, and returns
+ * false if nothing was read; on a non-blocking descriptor, that does
+ * not end the input.  hasLine returns true if readLine can return a
+ * line without reading, and isClosed returns true if the input has
+ * ended and every line has been read.  Neither reads.
+ */
+
+   bool receive();
+   bool hasLine();
+   bool isClosed();
+
+private:
+
+   int fd;
+   int blockSize;
+   std::vector<char> buffer;
+   size_t start, end;
+   bool eof;
+
+   bool fill();
+
+   LineReader(const LineReader &);
+   LineReader & operator=(const LineReader &);
+
+};
+
+/*
+ * Function: standardInput
+ * Usage: LineReader & input = standardInput();
+ * --------------------------------------------
+ * Returns the reader for the standard input of the process.
+ */
+
+LineReader & standardInput();
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * File: mapfile.cpp
+ * -----------------
+ * This file implements the mapfile.h interface.
+ */
+
+#include <cerrno>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "mapfile.h"
+#include "../StanfordCPPLib/error.h"
+using namespace std;
+
+/*
+ * Implementation notes: MappedFile
+ * --------------------------------
+ * An empty file is not mapped at all, since mmap rejects a length of 0.
+ * The descriptor can be closed as soon as the mapping exists.
+ */
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string & filename) {
+   data = nullptr;
+   size = 0;
+   int fd = _open(filename.c_str(), _O_RDONLY | _O_BINARY);
+   if (fd < 0) error("Can't open " + filename);
+   char block[65536];
+   while (true) {
+      int n = _read(fd, block, sizeof block);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) {
+         _close(fd);
+         error("Can't read " + filename);
+      }
+      if (n == 0) break;
+      copy.insert(copy.end(), block, block + n);
+   }
+   _close(fd);
+   size = copy.size();
+   if (size > 0) data = &copy[0];
+}
+
+MappedFile::~MappedFile() {
+}
+
+#else
+
+MappedFile::MappedFile(const string & filename) {
+   data = nullptr;
+   size = 0;
+   int fd = open(filename.c_str(), O_RDONLY);
+   if (fd < 0) error("Can't open " + filename);
+   struct stat info;
+   if (fstat(fd, &info) < 0) {
+      close(fd);
+      error("Can't read " + filename);
+   }
+   if (info.st_size > 0) {
+      void *map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED) {
+         close(fd);
+         error("Can't read " + filename);
+      }
+      madvise(map, info.st_size, MADV_SEQUENTIAL);
+      data = (const char *) map;
+      size = info.st_size;
+   }
+   close(fd);
+}
+
+MappedFile::~MappedFile() {
+   if (size > 0) munmap((void *) data, size);
+}
+
+#endif
+
+const char *MappedFile::getData() {
+   return data;
+}
+
+size_t MappedFile::getSize() {
+   return size;
+}
@@ -0,0 +1,66 @@
+/*
+ * File: mapfile.h
+ * ---------------
+ * This interface exports the MappedFile class, which gives read-only
+ * access to the whole contents of a file without copying it.
+ */
+
+#ifndef _mapfile_h
+#define _mapfile_h
+
+#include <string>
+#include <vector>
+
+/*
+ * Class: MappedFile
+ * -----------------
+ * A MappedFile maps a file into memory for as long as the object lives.
+ * On systems without mmap, the file is read into a buffer instead, so
+ * clients see the same interface either way.
+ */
+
+class MappedFile {
+
+public:
+
+/*
+ * Constructor: MappedFile
+ * Usage: MappedFile file(filename);
+ * ---------------------------------
+ * Maps the named file, calling error if it cannot be opened or read.
+ */
+
+   MappedFile(const std::string & filename);
+
+/*
+ * Destructor: ~MappedFile
+ * Usage: usually implicit
+ * -----------------------
+ * Unmaps the file.
+ */
+
+   ~MappedFile();
+
+/*
+ * Methods: getData, getSize
+ * Usage: const char *data = file.getData();
+ * -----------------------------------------
+ * Return the contents of the file and their length in bytes.  The data
+ * is not null-terminated and may be nullptr for an empty file.
+ */
+
+   const char *getData();
+   size_t getSize();
+
+private:
+
+   const char *data;
+   size_t size;
+   std::vector<char> copy;
+
+   MappedFile(const MappedFile &);
+   MappedFile & operator=(const MappedFile &);
+
+};
+
+#endif
@@ -0,0 +1,670 @@
+/*
+ * File: optimizer.cpp
+ * -------------------
+ * This file implements the optimizer.h interface.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "optimizer.h"
+using namespace std;
+
+/*
+ * Implementation notes: ranges
+ * ----------------------------
+ * The forward analysis keeps, for each point of the program, the set of
+ * variables that are defined on every path to it, together with an
+ * interval holding every value the variable may have there and a flag
+ * that is set when the value cannot be zero even though the interval
+ * spans zero.  A variable missing from the map may be undefined, so its
+ * reads keep their check.  A variable whose interval is a single value
+ * is a constant.
+ */
+
+struct Range {
+	int lo, hi;
+	bool nonzero;
+
+	bool isConst() const { return lo == hi; }
+	bool excludesZero() const { return nonzero || lo > 0 || hi < 0; }
+};
+
+typedef map<string, Range> Env;
+
+static Range makeRange(long long lo, long long hi, bool nonzero = false) {
+	Range range;
+	if (lo < INT_MIN || hi > INT_MAX) {
+		range.lo = INT_MIN;
+		range.hi = INT_MAX;
+		range.nonzero = false;
+		return range;
+	}
+	range.lo = (int) lo;
+	range.hi = (int) hi;
+	range.nonzero = nonzero || lo > 0 || hi < 0;
+	if (range.nonzero && range.lo == 0) range.lo = 1;
+	if (range.nonzero && range.hi == 0) range.hi = -1;
+	return range;
+}
+
+static Range unknown() {
+	return makeRange(INT_MIN, INT_MAX);
+}
+
+static Range known(int n) {
+	return makeRange(n, n);
+}
+
+/*
+ * Implementation notes: foldOp
+ * ----------------------------
+ * Applies an arithmetic operator to two constants.  Overflow wraps the
+ * way the hardware does when the program runs.  Division by zero is
+ * left alone so that the error is still reported when the program runs,
+ * and so is INT_MIN / -1, which traps.
+ */
+
+static bool foldOp(const string &op, int l, int r, int &result) {
+	unsigned ul = (unsigned) l, ur = (unsigned) r;
+	if (op == "+") result = (int) (ul + ur);
+	else if (op == "-") result = (int) (ul - ur);
+	else if (op == "*") result = (int) (ul * ur);
+	else if (op == "/") {
+		if (r == 0 || (l == INT_MIN && r == -1)) return false;
+		result = l / r;
+	}
+	else return false;
+	return true;
+}
+
+/*
+ * Implementation notes: applyOp
+ * -----------------------------
+ * Computes the interval of an operator from the intervals of its
+ * operands by trying the corners in 64-bit arithmetic.  An interval that
+ * may overflow becomes the full range, since the value wraps.  Division
+ * is bounded only when the sign of the divisor is known.
+ */
+
+static Range applyOp(const string &op, Range l, Range r) {
+	int folded;
+	if (l.isConst() && r.isConst() && foldOp(op, l.lo, r.lo, folded)) return known(folded);
+	long long a[2] = { l.lo, l.hi }, b[2] = { r.lo, r.hi };
+	if (op == "/" && r.lo <= 0 && r.hi >= 0) return unknown();
+	if (op == "/" && l.lo == INT_MIN && r.lo <= -1 && r.hi >= -1) return unknown();
+	long long lo = LLONG_MAX, hi = LLONG_MIN;
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 2; j++) {
+			long long v;
+			if (op == "+") v = a[i] + b[j];
+			else if (op == "-") v = a[i] - b[j];
+			else if (op == "*") v = a[i] * b[j];
+			else if (op == "/") v = a[i] / b[j];
+			else return unknown();
+			if (v < lo) lo = v;
+			if (v > hi) hi = v;
+		}
+	}
+	return makeRange(lo, hi, op == "*" && l.excludesZero() && r.excludesZero()
+	                         && lo >= INT_MIN && hi <= INT_MAX);
+}
+
+static bool hasAssignment(Expression *exp) {
+	if (exp->getType() != COMPOUND) return false;
+	CompoundExp *cp = (CompoundExp *) exp;
+	return cp->getOp() == "=" || hasAssignment(cp->getLHS()) || hasAssignment(cp->getRHS());
+}
+
+/*
+ * Implementation notes: propagate
+ * -------------------------------
+ * Walks an expression in evaluation order, updating env with the effect
+ * of the evaluation and returning the interval of its value.  A variable
+ * that has been read is defined afterwards, and a divisor is nonzero,
+ * since otherwise the program would have stopped.  When rewrite is true
+ * the expression is also rewritten in place: constants replace variables
+ * and fold operators, divisions whose divisor became a constant turn into
+ * ConstDivExp nodes, and the checks that cannot fail are turned off.
+ */
+
+static Range propagate(Expression *&exp, Env &env, bool rewrite) {
+	if (exp->getType() == CONSTANT) return known(((ConstantExp *) exp)->getValue());
+	if (exp->getType() == IDENTIFIER) {
+		IdentifierExp *id = (IdentifierExp *) exp;
+		auto it = env.find(id->getName());
+		if (it == env.end()) {
+			env[id->getName()] = unknown();
+			return unknown();
+		}
+		Range range = it->second;
+		if (rewrite && range.isConst()) {
+			delete exp;
+			exp = new ConstantExp(range.lo);
+		}
+		else if (rewrite) id->setChecked(false);
+		return range;
+	}
+	CompoundExp *cp = (CompoundExp *) exp;
+	Expression *lhs = cp->getLHS(), *rhs = cp->getRHS();
+	if (cp->getOp() == "=") {
+		Range range = propagate(rhs, env, rewrite);
+		cp->setRHS(rhs);
+		if (lhs->getType() == IDENTIFIER) env[((IdentifierExp *) lhs)->getName()] = range;
+		return range;
+	}
+	Range left = propagate(lhs, env, rewrite);
+	cp->setLHS(lhs);
+	Range right = propagate(rhs, env, rewrite);
+	cp->setRHS(rhs);
+	Range range = applyOp(cp->getOp(), left, right);
+	if (cp->getOp() == "/") {
+		if (rewrite && right.excludesZero()) cp->setChecked(false);
+		if (rhs->getType() == IDENTIFIER) {
+			Range &divisor = env[((IdentifierExp *) rhs)->getName()];
+			divisor = makeRange(divisor.lo, divisor.hi, true);
+		}
+	}
+	if (rewrite && range.isConst() && lhs->getType() == CONSTANT && rhs->getType() == CONSTANT) {
+		delete exp;
+		exp = new ConstantExp(range.lo);
+	} else if (rewrite && cp->getOp() == "/" && rhs->getType() == CONSTANT
+	           && dynamic_cast<ConstDivExp *>(cp) == nullptr) {
+		int divisor = ((ConstantExp *) rhs)->getValue();
+		if (divisor != 0 && divisor != -1) {
+			cp->setLHS(nullptr);
+			cp->setRHS(nullptr);
+			delete exp;
+			exp = new ConstDivExp(lhs, (ConstantExp *) rhs);
+		}
+	}
+	return range;
+}
+
+static void propagate(Statement *stmt, Env &env, bool rewrite) {
+	Expression *exp;
+	switch (stmt->getType()) {
+		case LET_STATEMENT: {
+			LET_Sta *let = (LET_Sta *) stmt;
+			exp = let->getExp();
+			Range range = propagate(exp, env, rewrite);
+			let->setExp(exp);
+			env[let->getVarName()] = range;
+			break;
+		}
+		case PRINT_STATEMENT:
+			exp = ((PRINT_Sta *) stmt)->getExp();
+			propagate(exp, env, rewrite);
+			((PRINT_Sta *) stmt)->setExp(exp);
+			break;
+		case INPUT_STATEMENT:
+			env[((INPUT_Sta *) stmt)->getVarName()] = unknown();
+			break;
+		case IF_STATEMENT:
+			exp = ((IF_Sta *) stmt)->getLHS();
+			propagate(exp, env, rewrite);
+			((IF_Sta *) stmt)->setLHS(exp);
+			exp = ((IF_Sta *) stmt)->getRHS();
+			propagate(exp, env, rewrite);
+			((IF_Sta *) stmt)->setRHS(exp);
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Implementation notes: refine
+ * ----------------------------
+ * Narrows the intervals of the variables an IF compares, using what the
+ * comparison says on the edge being followed.  On the fall-through edge
+ * of IF p = 0, for example, p is known to be nonzero.  Conditions that
+ * assign are left alone, as is any narrowing that would leave nothing.
+ */
+
+static Range evaluate(Expression *exp, Env &env) {
+	Env copy = env;
+	return propagate(exp, copy, false);
+}
+
+static void constrain(Range &range, const string &op, Range other) {
+	long long lo = range.lo, hi = range.hi;
+	bool nonzero = range.nonzero;
+	if (op == "=") {
+		lo = max(lo, (long long) other.lo);
+		hi = min(hi, (long long) other.hi);
+		nonzero = nonzero || other.excludesZero();
+	}
+	else if (op == "<>") {
+		if (!other.isConst()) return;
+		if (other.lo == 0) nonzero = true;
+		if (lo == other.lo) lo++;
+		if (hi == other.lo) hi--;
+	}
+	else if (op == "<") hi = min(hi, (long long) other.hi - 1);
+	else if (op == "<=") hi = min(hi, (long long) other.hi);
+	else if (op == ">") lo = max(lo, (long long) other.lo + 1);
+	else if (op == ">=") lo = max(lo, (long long) other.lo);
+	if (lo > hi || (nonzero && lo == 0 && hi == 0)) return;
+	range = makeRange(lo, hi, nonzero);
+}
+
+static string flip(const string &op) {
+	if (op == "<") return ">";
+	if (op == ">") return "<";
+	if (op == "<=") return ">=";
+	if (op == ">=") return "<=";
+	return op;
+}
+
+static void refine(Env &env, IF_Sta *test, bool taken) {
+	Expression *lhs = test->getLHS(), *rhs = test->getRHS();
+	if (hasAssignment(lhs) || hasAssignment(rhs)) return;
+	string op(1, test->getOp());
+	if (!taken) op = op == "=" ? "<>" : op == "<" ? ">=" : "<=";
+	Range left = evaluate(lhs, env), right = evaluate(rhs, env);
+	if (lhs->getType() == IDENTIFIER) constrain(env[((IdentifierExp *) lhs)->getName()], op, right);
+	if (rhs->getType() == IDENTIFIER) constrain(env[((IdentifierExp *) rhs)->getName()], flip(op), left);
+}
+
+/*
+ * Implementation notes: meet
+ * --------------------------
+ * Where paths join, a variable stays defined only if it is defined on
+ * both, and its interval grows to cover both.  Once a block has been
+ * reached often enough the meet widens instead: a bound that is still
+ * moving jumps to the next threshold, which is a value just around a
+ * constant some IF compares with, or else the end of the int range.
+ * Loops counting up to a limit thus settle in a few passes with the
+ * limit as their bound.  Returns true if into changed.
+ */
+
+static const int WIDEN_AFTER = 3;
+
+static void addThresholds(Expression *exp, vector<int> &thresholds) {
+	if (exp->getType() == CONSTANT) {
+		long long value = ((ConstantExp *) exp)->getValue();
+		for (long long v = value - 1; v <= value + 1; v++)
+			if (v >= INT_MIN && v <= INT_MAX) thresholds.push_back((int) v);
+	}
+	if (exp->getType() != COMPOUND) return;
+	addThresholds(((CompoundExp *) exp)->getLHS(), thresholds);
+	addThresholds(((CompoundExp *) exp)->getRHS(), thresholds);
+}
+
+static bool meet(Env &into, const Env &other, const vector<int> *thresholds) {
+	bool changed = false;
+	for (auto it = into.begin(); it != into.end();) {
+		auto o = other.find(it->first);
+		if (o == other.end()) {
+			it = into.erase(it);
+			changed = true;
+			continue;
+		}
+		Range a = it->second, b = o->second;
+		long long lo = min(a.lo, b.lo), hi = max(a.hi, b.hi);
+		if (thresholds != nullptr && lo < a.lo) {
+			auto t = upper_bound(thresholds->begin(), thresholds->end(), (int) lo);
+			lo = t == thresholds->begin() ? INT_MIN : *--t;
+		}
+		if (thresholds != nullptr && hi > a.hi) {
+			auto t = lower_bound(thresholds->begin(), thresholds->end(), (int) hi);
+			hi = t == thresholds->end() ? INT_MAX : *t;
+		}
+		Range range = makeRange(lo, hi, a.excludesZero() && b.excludesZero());
+		if (range.lo != a.lo || range.hi != a.hi || range.nonzero != a.nonzero) {
+			it->second = range;
+			changed = true;
+		}
+		++it;
+	}
+	return changed;
+}
+
+static Env edgeFacts(BasicBlock *block, BasicBlock *succ, const Env &out) {
+	Env env = out;
+	if (block->terminator == nullptr || block->terminator->getType() != IF_STATEMENT) return env;
+	if (block->jump == block->next) return env;
+	refine(env, (IF_Sta *) block->terminator, succ == block->jump);
+	return env;
+}
+
+static void propagateRanges(ControlFlowGraph &graph) {
+	const vector<BasicBlock *> &rpo = graph.getReversePostorder();
+	if (rpo.empty()) return;
+	vector<Env> facts(graph.getBlocks().size());
+	vector<int> visits(graph.getBlocks().size(), 0);
+	vector<int> thresholds;
+	for (size_t i = 0; i < rpo.size(); i++) {
+		Statement *test = rpo[i]->terminator;
+		if (test == nullptr || test->getType() != IF_STATEMENT) continue;
+		addThresholds(((IF_Sta *) test)->getLHS(), thresholds);
+		addThresholds(((IF_Sta *) test)->getRHS(), thresholds);
+	}
+	sort(thresholds.begin(), thresholds.end());
+	set<int> work;
+	visits[rpo[0]->index] = 1;
+	work.insert(rpo[0]->order);
+	while (!work.empty()) {
+		BasicBlock *block = rpo[*work.begin()];
+		work.erase(work.begin());
+		Env env = facts[block->index];
+		for (size_t i = 0; i < block->stmts.size(); i++) propagate(block->stmts[i], env, false);
+		for (size_t i = 0; i < block->succs.size(); i++) {
+			BasicBlock *succ = block->succs[i];
+			Env edge = edgeFacts(block, succ, env);
+			bool changed;
+			if (visits[succ->index] == 0) {
+				facts[succ->index] = edge;
+				changed = true;
+			}
+			else changed = meet(facts[succ->index], edge,
+			                    visits[succ->index] >= WIDEN_AFTER ? &thresholds : nullptr);
+			if (changed) {
+				visits[succ->index]++;
+				work.insert(succ->order);
+			}
+		}
+	}
+	for (size_t i = 0; i < rpo.size(); i++) {
+		Env env = facts[rpo[i]->index];
+		for (size_t j = 0; j < rpo[i]->stmts.size(); j++) propagate(rpo[i]->stmts[j], env, true);
+	}
+}
+
+/*
+ * Implementation notes: LiveSet
+ * -----------------------------
+ * A set of live variables that can also hold every variable but a few,
+ * which is what is live where the program may stop.  When all is true,
+ * names lists the variables that are not live; otherwise it lists the
+ * ones that are.
+ */
+
+struct LiveSet {
+	bool all;
+	set<string> names;
+
+	LiveSet() : all(false) {}
+
+	bool contains(const string &name) const {
+		return all != (names.count(name) != 0);
+	}
+
+	void use(const string &name) {
+		if (all) names.erase(name);
+		else names.insert(name);
+	}
+
+	void kill(const string &name) {
+		if (all) names.insert(name);
+		else names.erase(name);
+	}
+
+	void everything() {
+		all = true;
+		names.clear();
+	}
+
+	void merge(const LiveSet &other) {
+		if (all && other.all) {
+			set<string> both;
+			for (auto it = names.begin(); it != names.end(); ++it)
+				if (other.names.count(*it)) both.insert(*it);
+			names.swap(both);
+		}
+		else if (all) {
+			for (auto it = other.names.begin(); it != other.names.end(); ++it) names.erase(*it);
+		}
+		else if (other.all) {
+			set<string> dead = other.names;
+			for (auto it = names.begin(); it != names.end(); ++it) dead.erase(*it);
+			all = true;
+			names.swap(dead);
+		}
+		else names.insert(other.names.begin(), other.names.end());
+	}
+
+	bool operator==(const LiveSet &other) const {
+		return all == other.all && names == other.names;
+	}
+};
+
+/*
+ * Implementation notes: mayThrow, addUses
+ * ---------------------------------------
+ * These inspect the rewritten expressions.  An expression may stop the
+ * program if it reads a variable or divides with a check that is still
+ * on, or assigns to something that is not a variable.  INPUT does not stop
+ * the program: it asks again after an invalid number and reads the end
+ * of the input as 0.
+ */
+
+static bool mayThrow(Expression *exp) {
+	if (exp->getType() == CONSTANT) return false;
+	if (exp->getType() == IDENTIFIER) return ((IdentifierExp *) exp)->isChecked();
+	CompoundExp *cp = (CompoundExp *) exp;
+	if (cp->getOp() == "=") return cp->getLHS()->getType() != IDENTIFIER || mayThrow(cp->getRHS());
+	if (cp->getOp() == "/" && cp->isChecked()) return true;
+	return mayThrow(cp->getLHS()) || mayThrow(cp->getRHS());
+}
+
+static void addUses(Expression *exp, LiveSet &live) {
+	if (exp->getType() == IDENTIFIER) live.use(((IdentifierExp *) exp)->getName());
+	if (exp->getType() != COMPOUND) return;
+	CompoundExp *cp = (CompoundExp *) exp;
+	if (cp->getOp() != "=") addUses(cp->getLHS(), live);
+	addUses(cp->getRHS(), live);
+}
+
+static bool mayThrow(Statement *stmt) {
+	switch (stmt->getType()) {
+		case LET_STATEMENT: return mayThrow(((LET_Sta *) stmt)->getExp());
+		case PRINT_STATEMENT: return mayThrow(((PRINT_Sta *) stmt)->getExp());
+		case IF_STATEMENT:
+			return mayThrow(((IF_Sta *) stmt)->getLHS()) || mayThrow(((IF_Sta *) stmt)->getRHS());
+		default: return false;
+	}
+}
+
+/*
+ * Implementation notes: liveBefore
+ * --------------------------------
+ * Moves live from after the statement to before it.  A statement that
+ * may stop the program makes everything live.  Assignments inside an
+ * expression are not treated as kills, which only keeps more alive.
+ */
+
+static void liveBefore(Statement *stmt, LiveSet &live) {
+	if (mayThrow(stmt)) {
+		live.everything();
+		return;
+	}
+	switch (stmt->getType()) {
+		case LET_STATEMENT: {
+			LET_Sta *let = (LET_Sta *) stmt;
+			if (!hasAssignment(let->getExp())) live.kill(let->getVarName());
+			addUses(let->getExp(), live);
+			break;
+		}
+		case PRINT_STATEMENT:
+			addUses(((PRINT_Sta *) stmt)->getExp(), live);
+			break;
+		case INPUT_STATEMENT:
+			live.kill(((INPUT_Sta *) stmt)->getVarName());
+			break;
+		case IF_STATEMENT:
+			addUses(((IF_Sta *) stmt)->getLHS(), live);
+			addUses(((IF_Sta *) stmt)->getRHS(), live);
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Implementation notes: liveOut
+ * -----------------------------
+ * The program may stop after a block that ends with END, falls off the
+ * last line, or jumps to a line that does not exist.
+ */
+
+static LiveSet liveOut(BasicBlock *block, const vector<LiveSet> &facts) {
+	LiveSet live;
+	bool stops = block->jumpLine >= 0 && block->jump == nullptr;
+	if (block->terminator == nullptr || block->terminator->getType() == IF_STATEMENT)
+		stops = stops || block->next == nullptr;
+	if (block->terminator != nullptr && block->terminator->getType() == END_STATEMENT)
+		stops = true;
+	if (stops) live.everything();
+	for (size_t i = 0; i < block->succs.size(); i++) live.merge(facts[block->succs[i]->index]);
+	return live;
+}
+
+static void removeDeadStores(ControlFlowGraph &graph) {
+	const vector<BasicBlock *> &rpo = graph.getReversePostorder();
+	vector<LiveSet> facts(graph.getBlocks().size());
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t i = rpo.size(); i-- > 0;) {
+			BasicBlock *block = rpo[i];
+			LiveSet live = liveOut(block, facts);
+			for (size_t j = block->stmts.size(); j-- > 0;) liveBefore(block->stmts[j], live);
+			if (!(live == facts[block->index])) {
+				facts[block->index] = live;
+				changed = true;
+			}
+		}
+	}
+	for (size_t i = 0; i < rpo.size(); i++) {
+		BasicBlock *block = rpo[i];
+		LiveSet live = liveOut(block, facts);
+		vector<Statement *> kept;
+		for (size_t j = block->stmts.size(); j-- > 0;) {
+			Statement *stmt = block->stmts[j];
+			if (stmt->getType() == LET_STATEMENT && !mayThrow(stmt)
+			    && !hasAssignment(((LET_Sta *) stmt)->getExp())
+			    && !live.contains(((LET_Sta *) stmt)->getVarName()))
+				continue;
+			liveBefore(stmt, live);
+			kept.push_back(stmt);
+		}
+		block->stmts.assign(kept.rbegin(), kept.rend());
+	}
+}
+
+/*
+ * Implementation notes: findCountedLoops
+ * --------------------------------------
+ * Only blocks that jump back to themselves are handled, so the loop body
+ * is straight-line code that control cannot leave except by an error.
+ * The increment must be the statement just before the IF, and the IF
+ * must compare the variable itself with the bound.
+ */
+
+static void addNames(Expression *exp, set<string> &names) {
+	if (exp->getType() == IDENTIFIER) names.insert(((IdentifierExp *) exp)->getName());
+	if (exp->getType() != COMPOUND) return;
+	addNames(((CompoundExp *) exp)->getLHS(), names);
+	addNames(((CompoundExp *) exp)->getRHS(), names);
+}
+
+static void addAssigned(Expression *exp, set<string> &names) {
+	if (exp->getType() != COMPOUND) return;
+	CompoundExp *cp = (CompoundExp *) exp;
+	if (cp->getOp() == "=" && cp->getLHS()->getType() == IDENTIFIER)
+		names.insert(((IdentifierExp *) cp->getLHS())->getName());
+	addAssigned(cp->getLHS(), names);
+	addAssigned(cp->getRHS(), names);
+}
+
+static void addAssigned(Statement *stmt, set<string> &names) {
+	switch (stmt->getType()) {
+		case LET_STATEMENT:
+			names.insert(((LET_Sta *) stmt)->getVarName());
+			addAssigned(((LET_Sta *) stmt)->getExp(), names);
+			break;
+		case INPUT_STATEMENT:
+			names.insert(((INPUT_Sta *) stmt)->getVarName());
+			break;
+		case PRINT_STATEMENT:
+			addAssigned(((PRINT_Sta *) stmt)->getExp(), names);
+			break;
+		case IF_STATEMENT:
+			addAssigned(((IF_Sta *) stmt)->getLHS(), names);
+			addAssigned(((IF_Sta *) stmt)->getRHS(), names);
+			break;
+		default:
+			break;
+	}
+}
+
+static bool isVariable(Expression *exp, const string &name) {
+	return exp->getType() == IDENTIFIER && ((IdentifierExp *) exp)->getName() == name;
+}
+
+static bool getStep(LET_Sta *let, int &step) {
+	Expression *exp = let->getExp();
+	if (exp->getType() != COMPOUND) return false;
+	CompoundExp *cp = (CompoundExp *) exp;
+	Expression *lhs = cp->getLHS(), *rhs = cp->getRHS();
+	const string &var = let->getVarName();
+	if (cp->getOp() == "+" && isVariable(lhs, var) && rhs->getType() == CONSTANT)
+		step = ((ConstantExp *) rhs)->getValue();
+	else if (cp->getOp() == "+" && isVariable(rhs, var) && lhs->getType() == CONSTANT)
+		step = ((ConstantExp *) lhs)->getValue();
+	else if (cp->getOp() == "-" && isVariable(lhs, var) && rhs->getType() == CONSTANT)
+		step = (int) (0u - (unsigned) ((ConstantExp *) rhs)->getValue());
+	else return false;
+	return true;
+}
+
+static void findCountedLoops(ControlFlowGraph &graph) {
+	const vector<BasicBlock *> &blocks = graph.getBlocks();
+	for (size_t i = 0; i < blocks.size(); i++) {
+		BasicBlock *block = blocks[i];
+		size_t n = block->stmts.size();
+		if (block->jump != block || n < 2 || block->terminator->getType() != IF_STATEMENT) continue;
+		if (block->stmts[n - 2]->getType() != LET_STATEMENT) continue;
+		LET_Sta *let = (LET_Sta *) block->stmts[n - 2];
+		IF_Sta *test = (IF_Sta *) block->stmts[n - 1];
+		const string &var = let->getVarName();
+		int step;
+		if (!getStep(let, step)) continue;
+		char op = test->getOp();
+		Expression *bound;
+		if (isVariable(test->getLHS(), var)) bound = test->getRHS();
+		else if (isVariable(test->getRHS(), var)) {
+			bound = test->getLHS();
+			if (op == '<') op = '>';
+			else if (op == '>') op = '<';
+		}
+		else continue;
+		set<string> assigned, used;
+		for (size_t j = 0; j + 2 < n; j++) addAssigned(block->stmts[j], assigned);
+		addAssigned(bound, assigned);
+		addNames(bound, used);
+		bool invariant = !used.count(var) && !hasAssignment(bound);
+		for (auto it = used.begin(); it != used.end(); ++it)
+			if (assigned.count(*it)) invariant = false;
+		CountedLoop *counted = new CountedLoop;
+		counted->var = var;
+		counted->symbol = internSymbol(var);
+		counted->step = step;
+		counted->op = op;
+		counted->bound = bound;
+		counted->varWritten = assigned.count(var) != 0;
+		counted->boundInvariant = invariant;
+		block->counted = counted;
+	}
+}
+
+void optimizeProgram(ControlFlowGraph &graph) {
+	propagateRanges(graph);
+	removeDeadStores(graph);
+	findCountedLoops(graph);
+}
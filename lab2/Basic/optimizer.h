@@ -0,0 +1,49 @@
+/*
+ * File: optimizer.h
+ * -----------------
+ * This interface exports the whole-program optimizer, which rewrites
+ * the statements held by a control-flow graph using dataflow analyses
+ * over the graph.  The optimized program prints the same output and
+ * reports the same errors, in the same order, as the original one, and
+ * leaves the same variable values behind when it stops.
+ */
+
+#ifndef _optimizer_h
+#define _optimizer_h
+
+#include "flowgraph.h"
+
+/*
+ * Function: optimizeProgram
+ * Usage: optimizeProgram(graph);
+ * ------------------------------
+ * Optimizes the statements of the graph in place.  The passes are:
+ *
+ *  1. Value ranges, which track the interval of every variable along
+ *     each path, narrowed by the IF conditions on each edge.  This
+ *     replaces a variable by its value wherever it holds the same
+ *     constant on every path, folds the operators whose operands
+ *     become constant, turns off the DIVIDE BY ZERO check on every
+ *     division whose divisor cannot be zero, and switches divisions
+ *     whose divisor became constant to multiplication by magic numbers.
+ *
+ *  2. Definedness, which turns off the VARIABLE NOT DEFINED check on
+ *     every variable that is assigned or read on all paths before it.
+ *     This is computed together with the ranges.
+ *
+ *  3. Dead-store elimination, which drops a LET whose value is always
+ *     overwritten before it is read.  Because variables survive the
+ *     run, every variable is live where the program may stop, which
+ *     includes every statement that may report an error.
+ *
+ *  4. Counted loops, which marks every block that loops on itself by
+ *     stepping a variable by a constant and testing it, so that run can
+ *     execute the loop natively (see CountedLoop in flowgraph.h).
+ *
+ * The statements removed from the blocks are not freed; they stay owned
+ * by whoever owns the statements of the graph.
+ */
+
+void optimizeProgram(ControlFlowGraph &graph);
+
+#endif
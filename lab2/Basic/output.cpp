@@ -0,0 +1,165 @@
+/*
+ * File: output.cpp
+ * ----------------
+ * This file implements the output.h interface.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "output.h"
+#include "../StanfordCPPLib/strlib.h"
+using namespace std;
+
+OutputSink::OutputSink(int fd, int capacity) : buffer(capacity) {
+   this->fd = fd;
+   text = nullptr;
+   used = 0;
+   buffered = true;
+   writes = 0;
+}
+
+OutputSink::OutputSink(string & text, int capacity) : buffer(capacity) {
+   fd = -1;
+   this->text = &text;
+   used = 0;
+   buffered = true;
+   writes = 0;
+}
+
+OutputSink::~OutputSink() {
+   flush();
+}
+
+/*
+ * Implementation notes: write
+ * ---------------------------
+ * Text that does not fit in the buffer goes out with the buffered text
+ * first and is then written directly, so a long block costs no copy.
+ */
+
+void OutputSink::write(const char *data, size_t length) {
+   if (used + length > buffer.size()) {
+      flush();
+      if (length > buffer.size()) {
+         drain(data, length);
+         return;
+      }
+   }
+   memcpy(&buffer[used], data, length);
+   used += length;
+}
+
+void OutputSink::write(const string & str) {
+   write(str.data(), str.length());
+}
+
+void OutputSink::writeInt(int value) {
+   if (used + MAX_INTEGER_LENGTH > buffer.size()) flush();
+   if (MAX_INTEGER_LENGTH > buffer.size()) {
+      char digits[MAX_INTEGER_LENGTH];
+      write(digits, formatInteger(value, digits));
+      return;
+   }
+   used += formatInteger(value, &buffer[used]);
+}
+
+void OutputSink::writeLine(const string & str) {
+   write(str.data(), str.length());
+   endLine();
+}
+
+void OutputSink::endLine() {
+   write("\n", 1);
+   if (!buffered) flush();
+}
+
+void OutputSink::flush() {
+   if (used == 0) return;
+   drain(&buffer[0], used);
+   used = 0;
+}
+
+void OutputSink::setBuffered(bool flag) {
+   buffered = flag;
+   if (!buffered) flush();
+}
+
+bool OutputSink::isBuffered() {
+   return buffered;
+}
+
+long long OutputSink::getWriteCount() {
+   return writes;
+}
+
+bool OutputSink::hasPending() {
+   return !pending.empty();
+}
+
+void OutputSink::sendPending() {
+   if (pending.empty()) return;
+   pending.erase(0, send(pending.data(), pending.length()));
+}
+
+void OutputSink::flushFromSignal() {
+   if (text != nullptr) return;
+   send(pending.data(), pending.length());
+   send(buffer.data(), used);
+}
+
+/*
+ * Implementation notes: drain, send
+ * ---------------------------------
+ * Once any text is pending, everything after it is kept behind it, so
+ * that the text leaves in order.  The loop in send handles partial
+ * writes and calls interrupted by signals, and stops when a
+ * non-blocking descriptor is full.  A descriptor that fails for any
+ * other reason, such as a closed pipe, simply drops the text, just as
+ * an iostream in the failed state would.  send returns the number of
+ * bytes it is done with.
+ */
+
+void OutputSink::drain(const char *data, size_t length) {
+   if (text != nullptr) {
+      text->append(data, length);
+      writes++;
+      return;
+   }
+   if (!pending.empty()) {
+      pending.append(data, length);
+      sendPending();
+      return;
+   }
+   size_t sent = send(data, length);
+   if (sent < length) pending.assign(data + sent, length - sent);
+}
+
+size_t OutputSink::send(const char *data, size_t length) {
+   size_t sent = 0;
+   while (sent < length) {
+#ifdef _WIN32
+      int n = _write(fd, data + sent, (unsigned) (length - sent));
+#else
+      ssize_t n = ::write(fd, data + sent, length - sent);
+#endif
+      writes++;
+      if (n < 0) {
+         if (errno == EINTR) continue;
+         if (errno == EAGAIN || errno == EWOULDBLOCK) return sent;
+         return length;
+      }
+      sent += n;
+   }
+   return sent;
+}
+
+OutputSink & standardOutput() {
+   static OutputSink out(1);
+   return out;
+}
@@ -0,0 +1,170 @@
+/*
+ * File: output.h
+ * --------------
+ * This interface exports the OutputSink class, which collects the text
+ * the interpreter prints and hands it to the operating system in large
+ * blocks instead of one line at a time.
+ */
+
+#ifndef _output_h
+#define _output_h
+
+#include <string>
+#include <vector>
+
+/*
+ * Class: OutputSink
+ * -----------------
+ * An OutputSink writes to a file descriptor through a buffer.  In the
+ * default buffered mode, the text is only written out when the buffer
+ * fills or when the client calls flush, which the interpreter does
+ * before it waits for input, after it reports an error and when it
+ * quits.  In unbuffered mode, meant for interactive terminals, every
+ * line is written out as soon as it ends.
+ *
+ * A sink can also collect its text in a string, which lets a program
+ * that embeds the interpreter capture what each session prints.
+ *
+ * A sink never waits on a non-blocking descriptor.  Text that the
+ * descriptor does not take at once is kept, in order, until the client
+ * calls sendPending once the descriptor can be written again.
+ */
+
+class OutputSink {
+
+public:
+
+/*
+ * Constructor: OutputSink
+ * Usage: OutputSink out(fd);
+ *        OutputSink out(fd, capacity);
+ * ------------------------------------
+ * Creates a buffered sink that writes to the file descriptor fd, with a
+ * buffer of the given capacity in bytes.
+ */
+
+   OutputSink(int fd, int capacity = 65536);
+
+/*
+ * Constructor: OutputSink
+ * Usage: OutputSink out(text);
+ *        OutputSink out(text, capacity);
+ * --------------------------------------
+ * Creates a sink that appends to the string text instead of writing to
+ * a file descriptor.  The string must outlive the sink, and it only
+ * holds the text that has been flushed.
+ */
+
+   explicit OutputSink(std::string & text, int capacity = 4096);
+
+/*
+ * Destructor: ~OutputSink
+ * Usage: usually implicit
+ * -----------------------
+ * Writes out any text that is still buffered.
+ */
+
+   ~OutputSink();
+
+/*
+ * Methods: write, writeInt, writeLine, endLine
+ * Usage: out.write(str);
+ *        out.writeInt(value);
+ *        out.writeLine(str);
+ *        out.endLine();
+ * -------------------------------------------
+ * write appends text and writeInt the decimal form of an integer.
+ * endLine ends the current line and writeLine appends a whole line.
+ */
+
+   void write(const char *data, size_t length);
+   void write(const std::string & str);
+   void writeInt(int value);
+   void writeLine(const std::string & str);
+   void endLine();
+
+/*
+ * Method: flush
+ * Usage: out.flush();
+ * -------------------
+ * Writes out all buffered text.
+ */
+
+   void flush();
+
+/*
+ * Methods: setBuffered, isBuffered
+ * Usage: out.setBuffered(false);
+ * ------------------------------
+ * Switches between the buffered and the unbuffered mode.
+ */
+
+   void setBuffered(bool flag);
+   bool isBuffered();
+
+/*
+ * Method: getWriteCount
+ * Usage: long long n = out.getWriteCount();
+ * -----------------------------------------
+ * Returns the number of write calls made to the operating system, or
+ * the number of times the buffer was appended to the string.
+ */
+
+   long long getWriteCount();
+
+/*
+ * Methods: hasPending, sendPending
+ * Usage: if (out.hasPending()) out.sendPending();
+ * -----------------------------------------------
+ * hasPending returns true while text that a non-blocking descriptor
+ * did not take is kept in the sink, and sendPending writes as much of
+ * it as the descriptor takes now.  The sink keeps all it is given, so
+ * a client that must bound its memory has to stop printing while any
+ * text is pending.
+ */
+
+   bool hasPending();
+   void sendPending();
+
+/*
+ * Method: flushFromSignal
+ * Usage: standardOutput().flushFromSignal();
+ * ------------------------------------------
+ * Writes out the pending and the buffered text with bare write calls,
+ * for a signal handler of a process that is about to end.  It neither
+ * allocates nor changes the sink, so it is safe in a handler even if
+ * the signal arrives while the sink is being updated, but text may be
+ * written twice if the sink is used afterwards.  A sink that collects
+ * its text in a string writes nothing.
+ */
+
+   void flushFromSignal();
+
+private:
+
+   int fd;
+   std::string *text;
+   std::vector<char> buffer;
+   size_t used;
+   bool buffered;
+   long long writes;
+   std::string pending;
+
+   void drain(const char *data, size_t length);
+   size_t send(const char *data, size_t length);
+
+   OutputSink(const OutputSink &);
+   OutputSink & operator=(const OutputSink &);
+
+};
+
+/*
+ * Function: standardOutput
+ * Usage: OutputSink & out = standardOutput();
+ * -------------------------------------------
+ * Returns the sink for the standard output of the process.
+ */
+
+OutputSink & standardOutput();
+
+#endif
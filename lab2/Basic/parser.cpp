@@ -16,60 +16,114 @@
 using namespace std;
 
 /*
- * Implementation notes: parseExp
- * ------------------------------
- * This code just reads an expression and then checks for extra tokens.
+ * Implementation notes: parseExp, readE, readT
+ * --------------------------------------------
+ * The throwing functions are thin wrappers around the ones that report
+ * failure by returning nullptr, so that both report the same messages.
  */
 
 Expression *parseExp(TokenScanner & scanner) {
-   Expression *exp = readE(scanner);
+   string message;
+   Expression *exp = tryParseExp(scanner, &message);
+   if (exp == nullptr) error(message);
+   return exp;
+}
+
+static Expression *tryReadE(TokenScanner & scanner, int prec, string *message);
+static Expression *tryReadT(TokenScanner & scanner, string *message);
+
+Expression *readE(TokenScanner & scanner, int prec) {
+   string message;
+   Expression *exp = tryReadE(scanner, prec, &message);
+   if (exp == nullptr) error(message);
+   return exp;
+}
+
+Expression *readT(TokenScanner & scanner) {
+   string message;
+   Expression *exp = tryReadT(scanner, &message);
+   if (exp == nullptr) error(message);
+   return exp;
+}
+
+/*
+ * Implementation notes: tryParseExp
+ * ---------------------------------
+ * This code just reads an expression and then checks for extra tokens.
+ * The message is only built on failure, so a valid expression costs no
+ * more than it did when the errors were thrown.
+ */
+
+static Expression *fail(string *message, const string & text) {
+   if (message != nullptr) *message = text;
+   return nullptr;
+}
+
+Expression *tryParseExp(TokenScanner & scanner, string *message) {
+   Expression *exp = tryReadE(scanner, 0, message);
+   if (exp == nullptr) return nullptr;
    if (scanner.hasMoreTokens()) {
-      error("parseExp: Found extra token: " + scanner.nextToken());
+      delete exp;
+      return fail(message, "parseExp: Found extra token: " + scanner.nextToken());
    }
    return exp;
 }
 
 /*
- * Implementation notes: readE
- * Usage: exp = readE(scanner, prec);
- * ----------------------------------
+ * Implementation notes: tryReadE
+ * Usage: exp = tryReadE(scanner, prec, message);
+ * ----------------------------------------------
  * This version of readE uses precedence to resolve the ambiguity in
  * the grammar.  At each recursive level, the parser reads operators and
  * subexpressions until it finds an operator whose precedence is greater
  * than the prevailing one.  When a higher-precedence operator is found,
  * readE calls itself recursively to read in that subexpression as a unit.
+ * On failure the part of the tree built so far is freed.
  */
 
-Expression *readE(TokenScanner & scanner, int prec) {
-   Expression *exp = readT(scanner);
+static Expression *tryReadE(TokenScanner & scanner, int prec, string *message) {
+   Expression *exp = tryReadT(scanner, message);
+   if (exp == nullptr) return nullptr;
    string token;
    while (true) {
       token = scanner.nextToken();
       int newPrec = precedence(token);
       if (newPrec <= prec) break;
-      Expression *rhs = readE(scanner, newPrec);
-      exp = new CompoundExp(token, exp, rhs);
+      Expression *rhs = tryReadE(scanner, newPrec, message);
+      if (rhs == nullptr) {
+         delete exp;
+         return nullptr;
+      }
+      exp = makeCompound(token, exp, rhs);
    }
    scanner.saveToken(token);
    return exp;
 }
 
 /*
- * Implementation notes: readT
- * ---------------------------
+ * Implementation notes: tryReadT
+ * ------------------------------
  * This function scans a term, which is either an integer, an identifier,
  * or a parenthesized subexpression.
  */
 
-Expression *readT(TokenScanner & scanner) {
+static Expression *tryReadT(TokenScanner & scanner, string *message) {
    string token = scanner.nextToken();
    TokenType type = scanner.getTokenType(token);
    if (type == WORD) return new IdentifierExp(token);
-   if (type == NUMBER) return new ConstantExp(stringToInteger(token));
-   if (token != "(") error("Illegal term in expression");
-   Expression *exp = readE(scanner);
+   if (type == NUMBER) {
+      int value;
+      if (!parseInteger(token.data(), token.length(), value)) {
+         return fail(message, "stringToInteger: Illegal integer format (" + token + ")");
+      }
+      return new ConstantExp(value);
+   }
+   if (token != "(") return fail(message, "Illegal term in expression");
+   Expression *exp = tryReadE(scanner, 0, message);
+   if (exp == nullptr) return nullptr;
    if (scanner.nextToken() != ")") {
-      error("Unbalanced parentheses in expression");
+      delete exp;
+      return fail(message, "Unbalanced parentheses in expression");
    }
    return exp;
 }
@@ -87,3 +141,49 @@ int precedence(string token) {
    if (token == "*" || token == "/") return 3;
    return 0;
 }
+
+/*
+ * Implementation notes: makeCompound
+ * ----------------------------------
+ * Division by 0 keeps the checked / so that it reports the error, and
+ * division by -1 keeps it because the magic numbers cannot reproduce
+ * what / does for INT_MIN.  The remainder idiom is only recognized when
+ * both copies of a and of b are the same expression and cannot assign,
+ * since RemainderExp evaluates each of them once.
+ */
+
+static bool sameExpression(Expression *a, Expression *b) {
+   if (a->getType() != b->getType()) return false;
+   switch (a->getType()) {
+      case CONSTANT:
+         return ((ConstantExp *) a)->getValue() == ((ConstantExp *) b)->getValue();
+      case IDENTIFIER:
+         return ((IdentifierExp *) a)->getName() == ((IdentifierExp *) b)->getName();
+      case COMPOUND: {
+         CompoundExp *x = (CompoundExp *) a, *y = (CompoundExp *) b;
+         return x->getOp() == y->getOp() && x->getOp() != "="
+             && sameExpression(x->getLHS(), y->getLHS())
+             && sameExpression(x->getRHS(), y->getRHS());
+      }
+   }
+   return false;
+}
+
+static bool isRemainder(Expression *lhs, Expression *rhs) {
+   if (rhs->getType() != COMPOUND) return false;
+   CompoundExp *product = (CompoundExp *) rhs;
+   if (product->getOp() != "*" || product->getLHS()->getType() != COMPOUND) return false;
+   CompoundExp *quotient = (CompoundExp *) product->getLHS();
+   return quotient->getOp() == "/"
+       && sameExpression(quotient->getLHS(), lhs)
+       && sameExpression(quotient->getRHS(), product->getRHS());
+}
+
+Expression *makeCompound(string op, Expression *lhs, Expression *rhs) {
+   if (op == "/" && rhs->getType() == CONSTANT) {
+      int divisor = ((ConstantExp *) rhs)->getValue();
+      if (divisor != 0 && divisor != -1) return new ConstDivExp(lhs, (ConstantExp *) rhs);
+   }
+   if (op == "-" && isRemainder(lhs, rhs)) return new RemainderExp(lhs, rhs);
+   return new CompoundExp(op, lhs, rhs);
+}
@@ -23,6 +23,18 @@
 
 Expression *parseExp(TokenScanner & scanner);
 
+/*
+ * Function: tryParseExp
+ * Usage: Expression *exp = tryParseExp(scanner, &message);
+ * --------------------------------------------------------
+ * Parses an expression like parseExp but returns nullptr instead of
+ * calling error if the expression is malformed.  Nothing is leaked on
+ * failure, and if message is not nullptr it is set to the text parseExp
+ * would have reported.
+ */
+
+Expression *tryParseExp(TokenScanner & scanner, std::string *message = nullptr);
+
 /*
  * Function: readE
  * Usage: Expression *exp = readE(scanner, prec);
@@ -54,4 +66,15 @@ Expression *readT(TokenScanner & scanner);
 
 int precedence(std::string token);
 
+/*
+ * Function: makeCompound
+ * Usage: Expression *exp = makeCompound(op, lhs, rhs);
+ * ----------------------------------------------------
+ * Returns the node for lhs op rhs.  Divisions by a constant and the
+ * remainder idiom a - a / b * b get the specialized subclasses from
+ * exp.h; every other combination gets a plain CompoundExp.
+ */
+
+Expression *makeCompound(std::string op, Expression *lhs, Expression *rhs);
+
 #endif
@@ -8,19 +8,35 @@
  * the performance guarantees specified in the assignment.
  */
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <exception>
+#include <functional>
 #include <string>
+#include <thread>
+#include <utility>
+#include "compact.h"
+#include "image.h"
 #include "program.h"
 #include "statement.h"
+#include "optimizer.h"
+#include "../StanfordCPPLib/error.h"
+#include "../StanfordCPPLib/strlib.h"
 using namespace std;
 
-Program::Program() {
+Program::Program() : graph(nullptr), compact(false), suspended(false), preempted(false) {
 }
 
 Program::~Program() {
+	clear();
 }
 
 void Program::clear() {
+	invalidate();
+	for (auto it = S.begin(); it != S.end(); it++) delete it->stmt;
 	S.clear();
+	digests.clear();
 }
 
 void Program::addSourceLine(int lineNumber, string line) {
@@ -30,21 +46,192 @@ void Program::addSourceLine(int lineNumber, string line) {
 	scanner.setInput(line);
 	scanner.nextToken();
 	clause now = clause(lineNumber, line, getStatement(scanner));
-	auto it = S.find(now);
-	if (it == S.end()) S.insert(now);
-	else {
-		S.erase(it);
-		S.insert(now);
+	invalidate();
+	storeLine(now);
+}
+
+/*
+ * Implementation notes: storeLine
+ * -------------------------------
+ * A line that goes after every other one, which is the usual case, is
+ * inserted with the end of the set as the hint in constant time.  A
+ * line that is already there is replaced and its statement freed.
+ * The digest of the line is updated along with it, and in compact mode
+ * the text is stored in tokenized form.
+ */
+
+void Program::storeLine(clause &line) {
+	digests.set(line.lineNumber, lineDigest(line.lineNumber, line.line));
+	if (compact) {
+		string code = compactLine(line.lineNumber, line.line);
+		line.line.swap(code);
 	}
+	if (S.empty() || S.rbegin()->lineNumber < line.lineNumber) {
+		S.insert(S.end(), std::move(line));
+		return;
+	}
+	auto it = S.find(line);
+	if (it != S.end()) {
+		delete it->stmt;
+		it = S.erase(it);
+	}
+	S.insert(it, std::move(line));
 }
 
 void Program::removeSourceLine(int lineNumber) {
 	auto it = S.find(clause(lineNumber));
-	if (it != S.end()) S.erase(it);
+	if (it != S.end()) {
+		invalidate();
+		delete it->stmt;
+		S.erase(it);
+		digests.remove(lineNumber);
+	}
+}
+
+/*
+ * Implementation notes: loadSource
+ * --------------------------------
+ * The text is split into lines first.  The lines are then parsed in
+ * contiguous ranges, one range per worker thread, and every result is
+ * written to the slot of its own line, so the workers share nothing but
+ * the symbol table, which has its own lock.  Each line is scanned once:
+ * the line number is read off the front and the rest of the scanner is
+ * handed straight to getStatement.
+ *
+ * The results are then applied on the calling thread in the order of
+ * the text, which is what makes a repeated or deleted line and the
+ * order of the errors come out as if the lines had been typed.  An
+ * exception other than a parse error is rethrown after every statement
+ * parsed by any worker has been freed.
+ */
+
+struct ParsedLine {
+	enum { EMPTY, ADD, REMOVE, FAILED } kind;
+	int lineNumber;
+	Statement *stmt;
+	string text;
+};
+
+static const size_t MIN_LINES_PER_THREAD = 1024;
+
+static void parseLine(const char *text, size_t length, ParsedLine &result) {
+	result.kind = ParsedLine::EMPTY;
+	result.stmt = nullptr;
+	if (length == 0) return;
+	result.text.assign(text, length);
+	try {
+		TokenScanner scanner;
+		scanner.ignoreWhitespace();
+		scanner.scanNumbers();
+		scanner.setInput(result.text);
+		string fst = scanner.nextToken();
+		if (scanner.getTokenType(fst) != NUMBER) error("SYNTAX ERROR");
+		result.lineNumber = stringToInteger(fst);
+		if (!scanner.hasMoreTokens()) {
+			result.kind = ParsedLine::REMOVE;
+			return;
+		}
+		result.stmt = getStatement(scanner);
+		result.kind = ParsedLine::ADD;
+	} catch (ErrorException &ex) {
+		result.kind = ParsedLine::FAILED;
+		result.text = ex.getMessage();
+	}
+}
+
+static void parseRange(const vector<pair<const char *, size_t> > &spans, vector<ParsedLine> &results,
+                       size_t first, size_t last, exception_ptr &failure) {
+	try {
+		for (size_t i = first; i < last; i++) parseLine(spans[i].first, spans[i].second, results[i]);
+	} catch (...) {
+		failure = current_exception();
+	}
+}
+
+void Program::loadSource(const char *text, size_t length, vector<string> &errors, int threads) {
+	invalidate();
+	vector<pair<const char *, size_t> > spans;
+	const char *end = text + length;
+	while (text < end) {
+		const char *newline = (const char *) memchr(text, '\n', end - text);
+		const char *stop = newline == nullptr ? end : newline;
+		spans.push_back(make_pair(text, (size_t) (stop - text)));
+		text = stop + 1;
+	}
+	vector<ParsedLine> results(spans.size());
+	for (size_t i = 0; i < results.size(); i++) results[i].stmt = nullptr;
+	if (threads <= 0) threads = thread::hardware_concurrency();
+	size_t workers = min((size_t) max(threads, 1), spans.size() / MIN_LINES_PER_THREAD);
+	if (workers < 1) workers = 1;
+	vector<exception_ptr> failures(workers);
+	vector<thread> pool;
+	size_t per = (spans.size() + workers - 1) / workers;
+	for (size_t w = 1; w < workers; w++) {
+		size_t first = min(w * per, spans.size()), last = min(first + per, spans.size());
+		pool.push_back(thread(parseRange, cref(spans), ref(results), first, last, ref(failures[w])));
+	}
+	parseRange(spans, results, 0, min(per, spans.size()), failures[0]);
+	for (size_t w = 0; w < pool.size(); w++) pool[w].join();
+	for (size_t w = 0; w < workers; w++) {
+		if (failures[w] == nullptr) continue;
+		for (size_t i = 0; i < results.size(); i++) delete results[i].stmt;
+		rethrow_exception(failures[w]);
+	}
+	for (size_t i = 0; i < results.size(); i++) {
+		ParsedLine &result = results[i];
+		if (result.kind == ParsedLine::FAILED) {
+			errors.push_back(result.text);
+		} else if (result.kind == ParsedLine::REMOVE) {
+			removeSourceLine(result.lineNumber);
+		} else if (result.kind == ParsedLine::ADD) {
+			clause now = clause(result.lineNumber, std::move(result.text), result.stmt);
+			storeLine(now);
+		}
+	}
+}
+
+void Program::save(const string & filename) {
+	ImageWriter writer;
+	for (auto it = S.begin(); it != S.end(); it++)
+		writer.addLine(it->lineNumber, compact ? expandLine(it->lineNumber, it->line) : it->line, it->stmt);
+	writer.save(filename);
+}
+
+/*
+ * Implementation notes: load
+ * --------------------------
+ * The whole image is read before the program is touched, so that a
+ * damaged image leaves the program as it was.
+ */
+
+void Program::load(const string & filename) {
+	ImageReader reader(filename);
+	vector<clause> lines;
+	int lineNumber;
+	string text;
+	Statement *stmt;
+	try {
+		while (reader.nextLine(lineNumber, text, stmt))
+			lines.push_back(clause(lineNumber, text, stmt));
+	} catch (...) {
+		for (size_t i = 0; i < lines.size(); i++) delete lines[i].stmt;
+		throw;
+	}
+	clear();
+	for (size_t i = 0; i < lines.size(); i++) storeLine(lines[i]);
+}
+
+Digest Program::getDigest() {
+	return digests.getDigest();
+}
+
+Digest Program::getDigest(int first, int last) {
+	return digests.getDigest(first, last);
 }
 
 string Program::getSourceLine(int lineNumber) {
-	return S.find(clause(lineNumber))->line;
+	const string &line = S.find(clause(lineNumber))->line;
+	return compact ? expandLine(lineNumber, line) : line;
 }
 
 int Program::getFirstLineNumber() {
@@ -57,28 +244,219 @@ int Program::getNextLineNumber(int lineNumber) {
 	return it->lineNumber; 
 }
 
-void Program::display() {
-	for (auto it = S.begin(); it != S.end(); it++)
-		cout << it->line << endl;
+void Program::display(OutputSink &out) {
+	display(out, INT_MIN, INT_MAX);
+}
+
+/*
+ * Implementation notes: display
+ * -----------------------------
+ * The first line is found in the set in logarithmic time and the lines
+ * are written until one goes past the range, so listing a few lines of
+ * a long program costs no more than listing a short one.  The output is
+ * buffered while it is written even if it is normally flushed line by
+ * line, and flushed at the end.
+ */
+
+void Program::display(OutputSink &out, int first, int last) {
+	bool buffered = out.isBuffered();
+	out.setBuffered(true);
+	for (auto it = S.lower_bound(clause(first)); it != S.end() && it->lineNumber <= last; it++) {
+		if (compact) out.writeLine(expandLine(it->lineNumber, it->line));
+		else it->display(out);
+	}
+	out.setBuffered(buffered);
+}
+
+/*
+ * Implementation notes: setCompact
+ * --------------------------------
+ * The elements of the set cannot be changed in place, so the lines are
+ * taken out, converted and put back in order.  The new text is swapped
+ * in rather than assigned, since assigning a short string keeps the
+ * storage of the long one it replaces.
+ */
+
+void Program::setCompact(bool flag) {
+	if (flag == compact) return;
+	vector<clause> lines(S.begin(), S.end());
+	S.clear();
+	compact = flag;
+	for (size_t i = 0; i < lines.size(); i++) {
+		string text = flag ? compactLine(lines[i].lineNumber, lines[i].line)
+		                   : expandLine(lines[i].lineNumber, lines[i].line);
+		lines[i].line.swap(text);
+		S.insert(S.end(), std::move(lines[i]));
+	}
+}
+
+bool Program::isCompact() {
+	return compact;
 }
 
 void Program::run(EvalState &state) {
-	state.setValue("GOTO_DONE", 1);
-	state.setValue("PROGRAM_END_TAG",0);
-	for (auto it = S.begin(); it != S.end() ||  state.getValue("GOTO_DONE") == 0 ;) {
-	//	cout << "Run Clause:" << it->lineNumber << endl;
-		if (state.getValue("PROGRAM_END_TAG") == 1) return;
-		if (state.getValue("GOTO_DONE") == 0) {
-			state.setValue("GOTO_DONE", 1);
-			int val = state.getValue("GOTO_TAG");
-			auto itt = S.find(clause(val));
-			if (itt == S.end())
-				error("LINE NUMBER ERROR");
-			else it = itt;
+	state.resetControl();
+	suspended = preempted = false;
+	execute(getControlFlowGraph()->getEntry(), 0, state);
+}
+
+void Program::resume(EvalState &state) {
+	if (!suspended) return;
+	suspended = preempted = false;
+	execute(resumeBlock, resumeIndex, state);
+}
+
+bool Program::isSuspended() {
+	return suspended;
+}
+
+bool Program::isPreempted() {
+	return preempted;
+}
+
+/*
+ * Implementation notes: execute
+ * -----------------------------
+ * Only the last statement of a block can jump or end the program, so the
+ * control requests in the state are checked once per block instead of
+ * once per line.  A jump to a missing line has a nullptr edge and is
+ * reported when it is taken.  Blocks that form a counted loop by
+ * themselves are handed to runCountedLoop.
+ *
+ * The block and the index of the statement being run are all the state
+ * the loop has, so an INPUT that suspends is resumed by starting again
+ * from the two of them.  Nothing is saved unless the run suspends.
+ *
+ * The statements are counted against the slice of the state a block,
+ * or a pass of a counted loop, at a time.  When the slice runs out, the
+ * run is preempted before the next block, which resumes at its start.
+ */
+
+void Program::execute(BasicBlock *block, size_t index, EvalState &state) {
+	long long budget = state.getSlice() > 0 ? state.getSlice() : LLONG_MAX;
+	long long start = budget;
+	try {
+		while (block != nullptr) {
+			if (budget <= 0) {
+				suspended = preempted = true;
+				resumeBlock = block;
+				resumeIndex = 0;
+				break;
+			}
+			if (block->counted != nullptr) {
+				block = runCountedLoop(block, index, budget, state);
+				continue;
+			}
+			for (; index < block->stmts.size(); index++)
+				block->stmts[index]->execute(state);
+			index = 0;
+			budget -= block->stmts.size();
+			if (state.hasEnded()) break;
+			if (state.hasJump()) {
+				state.takeJump();
+				if (block->jump == nullptr) error("LINE NUMBER ERROR");
+				block = block->jump;
+			}
+			else block = block->next;
 		}
-		else {
-			if (it->stmt != nullptr)it->stmt->execute(state);
-			it++;
+	} catch (InputPending &) {
+		suspended = true;
+		resumeBlock = block;
+		resumeIndex = index;
+	} catch (...) {
+		state.countStatements(start - budget);
+		throw;
+	}
+	state.countStatements(start - budget);
+}
+
+/*
+ * Implementation notes: runCountedLoop
+ * ------------------------------------
+ * Runs the body of a counted loop and then does the work of the final
+ * LET and IF directly: the variable is kept in a local unless the body
+ * assigns it, and an invariant bound is evaluated only on the first
+ * pass, so the exit test is a plain comparison of two ints.  The state
+ * sees the same values and errors as it would from the statements.
+ *
+ * When the body is empty and the bound invariant, the remaining trips
+ * are counted with 64-bit arithmetic and the final value is stored at
+ * once, provided the variable cannot overflow on the way.  The LET and
+ * IF of the trips that are skipped are still charged, so the count of
+ * statements is the same as if they had run.
+ *
+ * The first pass starts the body at index, which is only nonzero when
+ * an INPUT in the body resumes, and index follows the statement being
+ * run.  Since the loop variable and the bound are read again on the
+ * first pass, resuming behaves as if the loop had not been left.  Each
+ * pass is taken from the budget, including the last one that fails the
+ * exit test, and when it runs out the loop returns its own block, so
+ * that the run is preempted on the back edge.
+ */
+
+static bool compare(char op, int lhs, int rhs) {
+	return (op == '=' && lhs == rhs) || (op == '<' && lhs < rhs) || (op == '>' && lhs > rhs);
+}
+
+BasicBlock *Program::runCountedLoop(BasicBlock *block, size_t &index, long long &budget,
+                                    EvalState &state) {
+	CountedLoop *loop = block->counted;
+	size_t body = block->stmts.size() - 2;
+	int value = 0, bound = 0;
+	int *cell = nullptr;
+	unsigned long long cellVersion = 0;
+	bool first = true;
+	while (true) {
+		for (; index < body; index++) block->stmts[index]->execute(state);
+		index = 0;
+		if (cell == nullptr || cellVersion != state.getVersion()) {
+			cell = state.modify(loop->symbol);
+			cellVersion = state.getVersion();
+		}
+		if (first || loop->varWritten) {
+			if (cell == nullptr) error("VARIABLE NOT DEFINED");
+			value = *cell;
+		}
+		value = (int) ((unsigned) value + (unsigned) loop->step);
+		*cell = value;
+		if (first || !loop->boundInvariant) bound = loop->bound->eval(state);
+		budget -= body + 2;
+		if (!compare(loop->op, value, bound)) return block->next;
+		if (first && body == 0 && loop->boundInvariant) {
+			long long step = loop->step, last = value;
+			if (loop->op == '<' && step > 0) last += (bound - last + step - 1) / step * step;
+			else if (loop->op == '>' && step < 0) last += (last - bound - step - 1) / -step * step;
+			if (last != value && last >= INT_MIN && last <= INT_MAX) {
+				state.setValue(loop->symbol, (int) last);
+				budget -= (last - value) / step * 2;
+				return block->next;
+			}
+		}
+		first = false;
+		if (budget <= 0) return block;
+	}
+}
+
+ControlFlowGraph *Program::getControlFlowGraph() {
+	if (graph == nullptr) {
+		vector<SourceLine> lines;
+		lines.reserve(S.size());
+		for (auto it = S.begin(); it != S.end(); it++) {
+			Statement *stmt = it->stmt ? it->stmt->clone() : nullptr;
+			if (stmt != nullptr) code.push_back(stmt);
+			SourceLine line = { it->lineNumber, stmt };
+			lines.push_back(line);
 		}
+		graph = new ControlFlowGraph(lines);
+		optimizeProgram(*graph);
 	}
+	return graph;
+}
+
+void Program::invalidate() {
+	suspended = preempted = false;
+	delete graph;
+	graph = nullptr;
+	for (size_t i = 0; i < code.size(); i++) delete code[i];
+	code.clear();
 }
@@ -10,7 +10,10 @@
 
 #include <string>
 #include <set>
+#include <vector>
 #include "statement.h"
+#include "digest.h"
+#include "flowgraph.h"
 using namespace std;
 
 class Program;
@@ -25,7 +28,7 @@ public:
 	clause(int lineNumber, string line = "", Statement *stmt = nullptr) :
 		lineNumber(lineNumber), line(line), stmt(stmt) {}
 
-	void display() { cout << line << endl; }
+	void display(OutputSink &out) const { out.writeLine(line); }
 
 	bool operator < (const clause &cl) const {
 		return lineNumber < cl.lineNumber;
@@ -103,6 +106,54 @@ public:
 
    void removeSourceLine(int lineNumber);
 
+/*
+ * Method: loadSource
+ * Usage: program.loadSource(text, length, errors);
+ *        program.loadSource(text, length, errors, threads);
+ * ---------------------------------------------------------
+ * Adds every line of text, which holds numbered program lines as they
+ * would be typed.  A line that would be rejected if it were typed is
+ * skipped and the message it would get is appended to errors, and so
+ * is a line without a line number.  The lines are parsed on up to
+ * threads threads, or one per core if threads is 0, but the program
+ * and the errors come out exactly as if the lines had been typed one
+ * after the other.  Lines in increasing order are added in constant
+ * time each.
+ */
+
+   void loadSource(const char *text, size_t length, vector<string> &errors,
+                   int threads = 0);
+
+/*
+ * Methods: save, load
+ * Usage: program.save(filename);
+ *        program.load(filename);
+ * ------------------------------
+ * save writes the parsed lines of the program to a binary image (see
+ * image.h), and load replaces the program with the lines of an image
+ * without scanning or parsing them again.  Both call error if the file
+ * cannot be written or read; load leaves the program as it was if the
+ * image is damaged.
+ */
+
+   void save(const std::string & filename);
+   void load(const std::string & filename);
+
+/*
+ * Methods: getDigest
+ * Usage: Digest digest = program.getDigest();
+ *        Digest digest = program.getDigest(first, last);
+ * ------------------------------------------------------
+ * Returns the digest of the whole program, or of its lines numbered
+ * from first to last inclusive, which changes whenever a line in it is
+ * added, changed or removed (see digest.h).  The digests are kept up to
+ * date as the program is edited: the first form takes constant time and
+ * the second O(log n).
+ */
+
+   Digest getDigest();
+   Digest getDigest(int first, int last);
+
 /*
  * Method: getSourceLine
  * Usage: string line = program.getSourceLine(lineNumber);
@@ -134,10 +185,85 @@ public:
 
    int getNextLineNumber(int lineNumber);
 
-   void display();
+/*
+ * Method: display
+ * Usage: program.display(out);
+ *        program.display(out, first, last);
+ * -----------------------------------------
+ * Writes the source lines of the program to out in line-number order.
+ * The second form writes only the lines numbered from first to last.
+ */
+
+   void display(OutputSink & out);
+   void display(OutputSink & out, int first, int last);
+
+/*
+ * Methods: setCompact, isCompact
+ * Usage: program.setCompact(true);
+ * --------------------------------
+ * Switches the storage of the source lines between plain text and the
+ * tokenized form from compact.h, which takes less memory and is turned
+ * back into the same text for LIST, getSourceLine and save.
+ */
+
+   void setCompact(bool flag);
+   bool isCompact();
+
+/*
+ * Method: run
+ * Usage: program.run(state);
+ * --------------------------
+ * Runs the program a basic block at a time, starting from the first
+ * line, until it falls off the end or executes END.
+ */
+
    void run(EvalState &state);
+
+/*
+ * Methods: resume, isSuspended, isPreempted
+ * Usage: if (program.isSuspended()) program.resume(state);
+ * --------------------------------------------------------
+ * When the state is suspendable and an INPUT statement finds no line to
+ * read, run returns early and leaves the program suspended at the INPUT.
+ * When the state has a slice and the run uses it up, run returns early
+ * and leaves the program suspended and preempted.  resume continues the
+ * run from where it stopped, and may suspend again; it does nothing if
+ * the program is not suspended.  Any change to the program drops the
+ * suspended run.
+ */
+
+   void resume(EvalState &state);
+   bool isSuspended();
+   bool isPreempted();
+
+/*
+ * Method: getControlFlowGraph
+ * Usage: ControlFlowGraph *graph = program.getControlFlowGraph();
+ * ---------------------------------------------------------------
+ * Returns the control-flow graph of the program.  The graph is built
+ * the first time it is needed and kept until the program is edited, so
+ * the pointer must not be used after the next change to the program.
+ * Its blocks hold optimized copies of the statements, which are what
+ * run executes; the parsed lines themselves are never changed.
+ */
+
+   ControlFlowGraph *getControlFlowGraph();
+
 private:
 	set<clause> S;
-// Fill this in with whatever types and instance variables you need
+	ControlFlowGraph *graph;
+	vector<Statement *> code;
+	DigestTree digests;
+	bool compact;
+	bool suspended;
+	bool preempted;
+	BasicBlock *resumeBlock;
+	size_t resumeIndex;
+
+	void invalidate();
+	void storeLine(clause &line);
+	void execute(BasicBlock *block, size_t index, EvalState &state);
+	BasicBlock *runCountedLoop(BasicBlock *block, size_t &index, long long &budget,
+	                           EvalState &state);
 };
 #endif
@@ -0,0 +1,390 @@
+/*
+ * File: server.cpp
+ * ----------------
+ * This file implements the server.h interface.
+ */
+
+#include <string>
+#include "server.h"
+#include "../StanfordCPPLib/error.h"
+using namespace std;
+
+#ifdef __linux__
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "session.h"
+
+/*
+ * Implementation notes: connections
+ * ---------------------------------
+ * The buffers of a connection are much smaller than those of the
+ * standard streams, since a server may hold thousands of them, most of
+ * them idle.  The reader still grows for longer lines.
+ */
+
+static const int CONNECTION_BUFFER = 4096;
+static const int MAX_EVENTS = 256;
+static const int REPORT_INTERVAL = 1000;
+
+/*
+ * Type: Connection
+ * ----------------
+ * readable is set when epoll has reported an event that the worker has
+ * not read for yet; a connection that goes back to the run queue
+ * because its program was preempted has nothing new to read.  quit is
+ * set when the client has sent QUIT, and the connection closes once
+ * the output before it has gone out.  cpuTime and slices account for
+ * the work done on behalf of the session, which is numbered by id in
+ * the order of connection.
+ */
+
+struct Connection {
+   int fd;
+   long id;
+   LineReader input;
+   OutputSink output;
+   Session session;
+   bool readable;
+   bool quit;
+   double cpuTime;
+   long long slices;
+
+   Connection(int fd, long id, const ServerOptions & options)
+      : fd(fd), id(id), input(fd, CONNECTION_BUFFER), output(fd, CONNECTION_BUFFER),
+        session(input, output) {
+      session.setSuspendable(true);
+      session.setSlice(options.slice);
+      session.setImageDirectory(options.imageDirectory);
+      readable = quit = false;
+      cpuTime = 0;
+      slices = 0;
+   }
+};
+
+/*
+ * Class: WorkQueue
+ * ----------------
+ * The run queue: the connections that are ready to be served, in the
+ * order they became ready.  pop waits until there is one.  getLength
+ * and getPeak return the current and the largest length of the queue.
+ */
+
+class WorkQueue {
+
+public:
+
+   WorkQueue() {
+      peak = 0;
+   }
+
+   void push(Connection *conn) {
+      {
+         lock_guard<mutex> guard(lock);
+         ready.push_back(conn);
+         if (ready.size() > peak) peak = ready.size();
+      }
+      wakeup.notify_one();
+   }
+
+   Connection *pop() {
+      unique_lock<mutex> guard(lock);
+      while (ready.empty()) wakeup.wait(guard);
+      Connection *conn = ready.front();
+      ready.pop_front();
+      return conn;
+   }
+
+   size_t getLength() {
+      lock_guard<mutex> guard(lock);
+      return ready.size();
+   }
+
+   size_t getPeak() {
+      lock_guard<mutex> guard(lock);
+      return peak;
+   }
+
+private:
+
+   mutex lock;
+   condition_variable wakeup;
+   deque<Connection *> ready;
+   size_t peak;
+
+};
+
+/*
+ * Type: SchedulerStats
+ * --------------------
+ * The counters of the scheduler, which workers update and the thread
+ * that waits for events reports, and the stream they are reported on,
+ * which is nullptr if they are not.  Lines are written to the stream
+ * under the lock, so that they do not interleave.
+ */
+
+struct SchedulerStats {
+   std::ostream *out;
+   mutex lock;
+   atomic<long> sessions;
+   atomic<long long> slices;
+   atomic<long long> preemptions;
+
+   SchedulerStats(std::ostream *out) : out(out), sessions(0), slices(0), preemptions(0) {
+      /* Empty */
+   }
+
+   void write(const string & line) {
+      lock_guard<mutex> guard(lock);
+      *out << line << flush;
+   }
+};
+
+enum Outcome { CLOSED, IDLE, BLOCKED, RUNNABLE };
+
+static double threadCpuTime() {
+   timespec now;
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+   return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Implementation notes: serveConnection
+ * -------------------------------------
+ * The worker reads what has arrived and processes every complete line.
+ * A session that is waiting at INPUT is resumed first, and takes as many
+ * lines as it needs; if it is still waiting, the rest of the input has
+ * to wait for the next event.  A partial line stays in the reader until
+ * the rest arrives.
+ *
+ * A session whose program was preempted runs one more slice when its
+ * turn comes, and once anything has run on this turn, the connection
+ * goes to the back of the run queue as soon as a program is preempted.
+ * Lines that arrive in the meantime stay in the socket until the
+ * program finishes or waits for input.  Since epoll is not watching a
+ * runnable connection, the worker checks that the client is still
+ * there before it puts the connection back, so that a program that
+ * never ends does not outlive its client.
+ *
+ * The socket is non-blocking, so a worker never waits for a client to
+ * read.  Output the socket does not take stays in the sink, and the
+ * session is parked: nothing more runs until epoll reports that the
+ * socket is writable and the output has gone out.  A session therefore
+ * holds at most about a slice of output more than the socket does.
+ */
+
+static bool isHungUp(int fd) {
+   pollfd check;
+   check.fd = fd;
+   check.events = 0;
+   return poll(&check, 1, 0) > 0 && (check.revents & (POLLHUP | POLLERR)) != 0;
+}
+
+static Outcome serveConnection(Connection *conn) {
+   conn->output.sendPending();
+   if (conn->readable) conn->input.receive();
+   conn->readable = false;
+   long long before = conn->session.getState().getStatementCount();
+   string line;
+   bool served = false;
+   while (!conn->quit && !conn->output.hasPending()) {
+      if (conn->session.isRunnable()) {
+         if (served) break;
+         conn->session.resume();
+      } else if (conn->session.isWaiting()) {
+         conn->session.resume();
+         if (conn->session.isWaiting()) break;
+      } else if (conn->input.hasLine()) {
+         conn->input.readLine(line);
+         conn->quit = !conn->session.processLine(line);
+      } else {
+         break;
+      }
+      served = true;
+   }
+   if (conn->session.getState().getStatementCount() != before) conn->slices++;
+   conn->output.flush();
+   if (conn->output.hasPending()) return BLOCKED;
+   if (conn->quit) return CLOSED;
+   if (conn->session.isRunnable()) return isHungUp(conn->fd) ? CLOSED : RUNNABLE;
+   return conn->input.isClosed() ? CLOSED : IDLE;
+}
+
+/*
+ * Implementation notes: runWorker
+ * -------------------------------
+ * Every connection is registered with EPOLLONESHOT, so that only one
+ * worker serves it at a time.  When the worker is done, it arms the
+ * connection again, for input if it is idle and for output if it is
+ * blocked, or puts it straight back on the run queue if its program is
+ * runnable.  A blocked connection is not armed for input, since input
+ * that is not read would wake it again at once.
+ */
+
+static void reportSession(Connection *conn, SchedulerStats *stats) {
+   ostringstream line;
+   line << "session " << conn->id << ": " << fixed << setprecision(1)
+        << conn->cpuTime * 1000 << " ms cpu, "
+        << conn->session.getState().getStatementCount() << " statements, "
+        << conn->slices << " slices" << endl;
+   stats->write(line.str());
+}
+
+static void runWorker(int poller, WorkQueue *queue, SchedulerStats *stats) {
+   while (true) {
+      Connection *conn = queue->pop();
+      double start = threadCpuTime();
+      long long slices = conn->slices;
+      Outcome outcome;
+      try {
+         outcome = serveConnection(conn);
+      } catch (...) {
+         outcome = CLOSED;
+      }
+      conn->cpuTime += threadCpuTime() - start;
+      stats->slices += conn->slices - slices;
+      if (outcome == RUNNABLE) {
+         stats->preemptions++;
+         queue->push(conn);
+         continue;
+      }
+      if (outcome == IDLE || outcome == BLOCKED) {
+         epoll_event event;
+         event.events = (outcome == IDLE ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT;
+         event.data.ptr = conn;
+         if (epoll_ctl(poller, EPOLL_CTL_MOD, conn->fd, &event) == 0) continue;
+      }
+      epoll_ctl(poller, EPOLL_CTL_DEL, conn->fd, nullptr);
+      if (stats->out != nullptr) reportSession(conn, stats);
+      stats->sessions--;
+      int fd = conn->fd;
+      delete conn;
+      close(fd);
+   }
+}
+
+/*
+ * Implementation notes: reportScheduler
+ * -------------------------------------
+ * The summary is written at most once a second, and only when some
+ * slice has run since the last one, so that an idle server stays quiet.
+ */
+
+static void reportScheduler(long long slice, WorkQueue *queue, SchedulerStats *stats) {
+   ostringstream line;
+   line << "scheduler: slice " << slice << " statements, run queue "
+        << queue->getLength() << " (peak " << queue->getPeak() << "), "
+        << stats->sessions << " sessions, " << stats->slices << " slices, "
+        << stats->preemptions << " preemptions" << endl;
+   stats->write(line.str());
+}
+
+/*
+ * Implementation notes: serveSessions
+ * -----------------------------------
+ * The file limit is raised as far as the system allows, since every
+ * connection takes a descriptor.  SIGPIPE is ignored so that a client
+ * that goes away while its output is being written only ends its own
+ * session.  The listening socket is drained on every event.  It and
+ * the connections are all non-blocking, so that only the thread that
+ * waits for events ever waits.
+ */
+
+static void raiseFileLimit() {
+   rlimit limit;
+   if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+      limit.rlim_cur = limit.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &limit);
+   }
+}
+
+void serveSessions(const string & path, const ServerOptions & options) {
+   sockaddr_un address;
+   memset(&address, 0, sizeof address);
+   address.sun_family = AF_UNIX;
+   if (path.length() >= sizeof address.sun_path) error("Socket path too long: " + path);
+   strcpy(address.sun_path, path.c_str());
+   signal(SIGPIPE, SIG_IGN);
+   raiseFileLimit();
+   int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if (listener < 0) error("Can't create socket: " + string(strerror(errno)));
+   unlink(path.c_str());
+   if (bind(listener, (sockaddr *) &address, sizeof address) < 0
+       || listen(listener, SOMAXCONN) < 0) {
+      string reason = strerror(errno);
+      close(listener);
+      error("Can't listen on " + path + ": " + reason);
+   }
+   int poller = epoll_create1(EPOLL_CLOEXEC);
+   epoll_event event;
+   event.events = EPOLLIN;
+   event.data.ptr = nullptr;
+   if (poller < 0 || epoll_ctl(poller, EPOLL_CTL_ADD, listener, &event) < 0) {
+      error("Can't wait for connections: " + string(strerror(errno)));
+   }
+   WorkQueue queue;
+   SchedulerStats stats(options.stats);
+   vector<thread> pool;
+   for (int i = 0; i < options.workers; i++) {
+      pool.push_back(thread(runWorker, poller, &queue, &stats));
+   }
+   epoll_event events[MAX_EVENTS];
+   long long reported = 0;
+   long connections = 0;
+   time_t lastReport = time(nullptr);
+   while (true) {
+      int timeout = options.stats != nullptr ? REPORT_INTERVAL : -1;
+      int n = epoll_wait(poller, events, MAX_EVENTS, timeout);
+      for (int i = 0; i < n; i++) {
+         Connection *conn = (Connection *) events[i].data.ptr;
+         if (conn != nullptr) {
+            conn->readable = true;
+            queue.push(conn);
+            continue;
+         }
+         int fd;
+         while ((fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+            conn = new Connection(fd, ++connections, options);
+            event.events = EPOLLIN | EPOLLONESHOT;
+            event.data.ptr = conn;
+            if (epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event) < 0) {
+               delete conn;
+               close(fd);
+            } else {
+               stats.sessions++;
+            }
+         }
+      }
+      if (options.stats != nullptr && stats.slices != reported && time(nullptr) != lastReport) {
+         reported = stats.slices;
+         lastReport = time(nullptr);
+         reportScheduler(options.slice, &queue, &stats);
+      }
+   }
+}
+
+#else
+
+void serveSessions(const string & path, const ServerOptions & options) {
+   (void) path;
+   (void) options;
+   error("Server mode is only available on Linux");
+}
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * File: server.h
+ * --------------
+ * This interface exports the server mode of the interpreter, which
+ * runs one session for each client that connects to a Unix domain
+ * socket, all in a single process.
+ */
+
+#ifndef _server_h
+#define _server_h
+
+#include <ostream>
+#include <string>
+
+/*
+ * Type: ServerOptions
+ * -------------------
+ * The settings of a server: the number of worker threads, the number of
+ * statements a program runs before it is preempted, or 0 to let it run
+ * to the end, the directory that SAVE and LOAD are confined to, which is
+ * empty to turn them off, and the stream the server reports to, which
+ * is nullptr for none.
+ */
+
+struct ServerOptions {
+   int workers;
+   long long slice;
+   std::string imageDirectory;
+   std::ostream *stats;
+};
+
+/*
+ * Function: serveSessions
+ * Usage: serveSessions(path, options);
+ * ------------------------------------
+ * Listens on a Unix domain socket at path, replacing any socket that is
+ * already there, and serves clients until the process is stopped.  Each
+ * connection gets its own Session (see session.h): the lines the client
+ * sends are processed as if they were typed, and everything the session
+ * prints is sent back.  The session ends when the client closes its end
+ * or sends QUIT.
+ *
+ * A single thread waits for all connections with epoll and hands those
+ * that have sent something to a pool of worker threads, which process
+ * the complete lines, so idle clients cost memory but no time.  The
+ * sessions are suspendable, so a program that is waiting at INPUT holds
+ * no worker either; it is resumed when the client sends the line.
+ *
+ * Running programs take turns: a program is preempted after a slice of
+ * statements, and its connection goes to the back of the run queue, so
+ * that no loop keeps the others from running.  If there is a stream to
+ * report to, the server writes the CPU time, statements and slices of
+ * each session to it when the session ends, and once a second while
+ * programs run, the slice, the length of the run queue and the number
+ * of preemptions.
+ *
+ * Clients may only SAVE and LOAD images in the image directory, and
+ * not at all if there is none (see Session::setImageDirectory).
+ *
+ * Errors in setting up the socket are reported by calling error.
+ * Server mode is only available on Linux.
+ */
+
+void serveSessions(const std::string & path, const ServerOptions & options);
+
+#endif
@@ -0,0 +1,250 @@
+/*
+ * File: session.cpp
+ * -----------------
+ * This file implements the session.h interface.
+ */
+
+#include <cctype>
+#include <climits>
+#include <string>
+#include "session.h"
+#include "statement.h"
+#include "../StanfordCPPLib/error.h"
+#include "../StanfordCPPLib/strlib.h"
+#include "../StanfordCPPLib/tokenscanner.h"
+using namespace std;
+
+Session::Session() {
+   waiting = nullptr;
+   imagesConfined = false;
+}
+
+Session::Session(LineReader & input, OutputSink & output) {
+   waiting = nullptr;
+   imagesConfined = false;
+   state.setInput(input);
+   state.setOutput(output);
+}
+
+bool Session::processLine(const string & line) {
+   SymbolScope scope(symbols);
+   try {
+      return execute(line);
+   } catch (ErrorException & ex) {
+      reportError(ex);
+      return true;
+   }
+}
+
+void Session::setSuspendable(bool flag) {
+   state.setSuspendable(flag);
+}
+
+bool Session::isWaiting() {
+   return waiting != nullptr || (program.isSuspended() && !program.isPreempted());
+}
+
+void Session::setSlice(long long statements) {
+   state.setSlice(statements);
+}
+
+bool Session::isRunnable() {
+   return program.isPreempted();
+}
+
+void Session::setImageDirectory(const string & directory) {
+   imagesConfined = true;
+   imageDirectory = directory;
+}
+
+void Session::resume() {
+   SymbolScope scope(symbols);
+   try {
+      if (waiting != nullptr) {
+         Statement *stmt = waiting;
+         waiting = nullptr;
+         executeStatement(stmt);
+      } else {
+         program.resume(state);
+      }
+   } catch (ErrorException & ex) {
+      reportError(ex);
+   }
+}
+
+/*
+ * Implementation notes: run
+ * -------------------------
+ * A suspendable session that is waiting only resumes once the reader
+ * has a line or has seen the end of the input, so that it never spins.
+ * A preempted program simply runs its next slice.
+ */
+
+bool Session::run() {
+   SymbolScope scope(symbols);
+   LineReader & input = state.getInput();
+   string line;
+   while (true) {
+      if (isRunnable()) {
+         resume();
+      } else if (isWaiting()) {
+         if (!input.hasLine() && !input.isClosed()) input.receive();
+         resume();
+      } else if (!input.readLine(line)) {
+         break;
+      } else if (!processLine(line)) {
+         state.getOutput().flush();
+         return false;
+      }
+   }
+   state.getOutput().flush();
+   return true;
+}
+
+Program & Session::getProgram() {
+   return program;
+}
+
+EvalState & Session::getState() {
+   return state;
+}
+
+StatementCache & Session::getCache() {
+   return cache;
+}
+
+SymbolTable & Session::getSymbols() {
+   return symbols;
+}
+
+/*
+ * Implementation notes: readListRange
+ * -----------------------------------
+ * The rest of a LIST command is empty or one of a-b, a- and -b.  This
+ * function sets first and last to the numbers of the first and last
+ * lines it covers; a bound that is left out is the start or the end of
+ * the program.
+ */
+
+static int readLineNumber(TokenScanner & scanner, const string & token) {
+   int n;
+   if (scanner.getTokenType(token) != NUMBER
+       || !parseInteger(token.data(), token.length(), n)) {
+      error("SYNTAX ERROR");
+   }
+   return n;
+}
+
+static void readListRange(TokenScanner & scanner, int & first, int & last) {
+   first = INT_MIN;
+   last = INT_MAX;
+   if (!scanner.hasMoreTokens()) return;
+   string token = scanner.nextToken();
+   if (token != "-") {
+      first = readLineNumber(scanner, token);
+      if (scanner.nextToken() != "-") error("SYNTAX ERROR");
+      if (!scanner.hasMoreTokens()) return;
+   } else if (!scanner.hasMoreTokens()) {
+      error("SYNTAX ERROR");
+   }
+   last = readLineNumber(scanner, scanner.nextToken());
+   if (scanner.hasMoreTokens()) error("SYNTAX ERROR");
+}
+
+/*
+ * Implementation notes: execute
+ * -----------------------------
+ * LIST may be followed by a range of lines.  SAVE and LOAD take the
+ * rest of the line as the name of a program image.  The statements of
+ * PRINT, LET and INPUT commands are kept in the cache after they run,
+ * so a command that is repeated word for word is run again without
+ * scanning or parsing it.  A line is only cached once it has parsed,
+ * so a repeated syntax error is reported every time.
+ */
+
+bool Session::execute(const string & line) {
+   if (line == "") return true;
+   if (!isdigit((unsigned char) line[0])) {
+      Statement *cached = cache.lookup(line);
+      if (cached != nullptr) {
+         executeStatement(cached);
+         return true;
+      }
+   }
+   static const int SIZE = 5;
+   static const char *const cmd[SIZE] = { "RUN", "LIST", "HELP", "QUIT", "CLEAR" };
+   TokenScanner scanner;
+   scanner.ignoreWhitespace();
+   scanner.scanNumbers();
+   scanner.setInput(line);
+   string fst = scanner.nextToken();
+   int c = 0;
+   while (c < SIZE && fst != cmd[c]) c++;
+   if (c == 1) {
+      int first, last;
+      readListRange(scanner, first, last);
+      program.display(state.getOutput(), first, last);
+   } else if (c < SIZE) {
+      if (scanner.hasMoreTokens()) error("SYNTAX ERROR");
+      switch (c) {
+         case 0: program.run(state); break;
+         case 2: state.getOutput().writeLine("Nobody can help you!"); break;
+         case 3: state.getOutput().flush(); return false;
+         case 4: program.clear(); state.clear();
+      }
+   } else if (fst == "SAVE" || fst == "LOAD") {
+      string filename = imagePath(trim(line.substr(line.find(fst) + fst.length())));
+      if (fst == "SAVE") program.save(filename);
+      else program.load(filename);
+   } else if (scanner.getTokenType(fst) == NUMBER) {
+      if (scanner.hasMoreTokens()) {
+         program.addSourceLine(stringToInteger(fst), line);
+      } else {
+         program.removeSourceLine(stringToInteger(fst));
+      }
+   } else {
+      if (fst != "PRINT" && fst != "LET" && fst != "INPUT") error("SYNTAX ERROR");
+      Statement *stmt = nullptr;
+      if (fst == "PRINT") stmt = new PRINT_Sta;
+      else if (fst == "LET") stmt = new LET_Sta;
+      else stmt = new INPUT_Sta;
+      try {
+         stmt->parseSta(scanner);
+      } catch (...) {
+         delete stmt;
+         throw;
+      }
+      cache.insert(line, stmt);
+      executeStatement(stmt);
+   }
+   return true;
+}
+
+/*
+ * Implementation notes: executeStatement
+ * --------------------------------------
+ * The statement of a command that waits for input belongs to the cache,
+ * which cannot drop it while the session waits, since no command runs
+ * until the statement is done.
+ */
+
+void Session::executeStatement(Statement *stmt) {
+   try {
+      stmt->execute(state);
+   } catch (InputPending &) {
+      waiting = stmt;
+   }
+}
+
+string Session::imagePath(const string & name) {
+   if (name == "") error("SYNTAX ERROR");
+   if (!imagesConfined) return name;
+   if (imageDirectory == "") error("SAVE AND LOAD ARE DISABLED");
+   if (name[0] == '.' || name.find_first_of("/\\") != string::npos) error("INVALID FILE NAME");
+   return imageDirectory + "/" + name;
+}
+
+void Session::reportError(ErrorException & ex) {
+   state.getOutput().writeLine(ex.getMessage());
+   state.getOutput().flush();
+}
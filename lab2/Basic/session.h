@@ -0,0 +1,163 @@
+/*
+ * File: session.h
+ * ---------------
+ * This interface exports the Session class, which is one instance of
+ * the interpreter: a program, the values of its variables and the
+ * commands typed to it.  The command-line interpreter runs a single
+ * session on the standard streams; a program that embeds the
+ * interpreter can run as many as it likes.
+ */
+
+#ifndef _session_h
+#define _session_h
+
+#include <string>
+#include "evalstate.h"
+#include "../StanfordCPPLib/error.h"
+#include "input.h"
+#include "output.h"
+#include "program.h"
+#include "stmtcache.h"
+
+/*
+ * Class: Session
+ * --------------
+ * A session owns its program, its variables, its statement cache and
+ * the table of the names they use, and reads INPUT from and prints to
+ * the reader and sink it is given.  Sessions share nothing, so
+ * different sessions may be used from different threads at the same
+ * time, and the names a session has used are freed with it.  A single
+ * session must only be used by one thread at a time.  Dividing the
+ * smallest integer by -1 still traps, which stops the whole process and
+ * not just the session.
+ */
+
+class Session {
+
+public:
+
+/*
+ * Constructor: Session
+ * Usage: Session session;
+ *        Session session(input, output);
+ * --------------------------------------
+ * Creates an empty session.  The first form reads the standard input
+ * and prints to the standard output; the second uses input and output,
+ * which must outlive the session.
+ */
+
+   Session();
+   Session(LineReader & input, OutputSink & output);
+
+/*
+ * Method: processLine
+ * Usage: if (!session.processLine(line)) . . .
+ * --------------------------------------------
+ * Processes a line typed by the user: a program line, which begins with
+ * a number, one of the commands RUN, LIST, CLEAR, HELP, QUIT, SAVE and
+ * LOAD, or a PRINT, LET or INPUT statement, which runs at once.  Errors
+ * are printed to the output of the session, as the interpreter prints
+ * them.  Returns false if the line is QUIT, after flushing the output,
+ * and true otherwise.
+ */
+
+   bool processLine(const std::string & line);
+
+/*
+ * Methods: setSuspendable, isWaiting, resume
+ * Usage: session.setSuspendable(true);
+ *        if (session.isWaiting()) session.resume();
+ * -------------------------------------------------
+ * A suspendable session never waits for its input.  When an INPUT
+ * statement, in a program or typed as a command, finds no complete line
+ * in the reader, processLine returns and the session is left waiting
+ * for the line.  While isWaiting returns true, the lines of the input
+ * are the answers to INPUT and not commands: the client should call
+ * resume once more input has arrived, which carries on until the
+ * statement or the program finishes or waits again.  Errors are
+ * reported as processLine reports them.
+ */
+
+   void setSuspendable(bool flag);
+   bool isWaiting();
+   void resume();
+
+/*
+ * Methods: setSlice, isRunnable
+ * Usage: session.setSlice(10000);
+ *        while (session.isRunnable()) session.resume();
+ * -----------------------------------------------------
+ * A session with a slice of n statements runs a program for no more
+ * than about n statements at a time, so that one thread can take turns
+ * between many sessions.  When RUN or resume uses up the slice, it
+ * returns and leaves the program preempted: isRunnable returns true, and
+ * the client should call resume, which runs the next slice, before it
+ * processes any more lines.  A slice of 0, the default, runs programs to
+ * the end.
+ */
+
+   void setSlice(long long statements);
+   bool isRunnable();
+
+/*
+ * Method: setImageDirectory
+ * Usage: session.setImageDirectory(directory);
+ * --------------------------------------------
+ * Confines SAVE and LOAD to a directory, for sessions whose commands
+ * come from clients that must not reach the rest of the file system.
+ * The name after SAVE or LOAD must then be a plain file name, with no
+ * slashes and no leading dot, and refers to a file in the directory;
+ * an empty directory turns SAVE and LOAD off.  By default, the name is
+ * any path the process can open.
+ */
+
+   void setImageDirectory(const std::string & directory);
+
+/*
+ * Method: run
+ * Usage: session.run();
+ * ---------------------
+ * Processes the lines of the input of the session until it ends or a
+ * line is QUIT, and flushes the output, waiting for input as needed even
+ * if the session is suspendable.  Returns false if the session ended
+ * with QUIT.
+ */
+
+   bool run();
+
+/*
+ * Methods: getProgram, getState, getCache, getSymbols
+ * Usage: Program & program = session.getProgram();
+ * ------------------------------------------------
+ * Return the program, the variables, the statement cache and the table
+ * of names of the session.  The methods of the session make its table
+ * current while they run; code that parses into or runs the program of
+ * the session directly must do the same with a SymbolScope.
+ */
+
+   Program & getProgram();
+   EvalState & getState();
+   StatementCache & getCache();
+   SymbolTable & getSymbols();
+
+private:
+
+   SymbolTable symbols;
+   Program program;
+   EvalState state;
+   StatementCache cache;
+   Statement *waiting;
+   bool imagesConfined;
+   std::string imageDirectory;
+
+   bool execute(const std::string & line);
+   std::string imagePath(const std::string & name);
+   void executeStatement(Statement *stmt);
+   void reportError(ErrorException & ex);
+
+   Session(const Session &);
+   Session & operator=(const Session &);
+
+};
+
+#endif
@@ -9,6 +9,8 @@
 
 #include <string>
 #include "statement.h"
+#include "../StanfordCPPLib/error.h"
+#include "../StanfordCPPLib/strlib.h"
 #include "../StanfordCPPLib/tokenscanner.h"
 #include "parser.h"
 
@@ -35,10 +37,14 @@ static const string illegalNames[illegalCnt] = {
 	"LET","REM","GOTO","IF","THEN","INPUT","PRINT","END","LIST","RUN","QUIT","HELP","CLEAR"
 }; 
 	
-LET_Sta::LET_Sta(string varName,Expression *exp) : varName(varName), exp(exp) {}
+LET_Sta::LET_Sta(string varName,Expression *exp) : varName(varName), symbol(internSymbol(varName)), exp(exp) {}
+
+LET_Sta::~LET_Sta() {
+	delete exp;
+}
 
 void LET_Sta::execute(EvalState & state) {
-	state.setValue(varName, exp->eval(state));
+	state.setValue(symbol, exp->eval(state));
 }
 
 void LET_Sta::parseSta(TokenScanner &scanner) {
@@ -48,9 +54,30 @@ void LET_Sta::parseSta(TokenScanner &scanner) {
 	while(id < illegalCnt && illegalNames[id] != varName) id++;
 	if (type != WORD || scanner.nextToken() != "=" || id != illegalCnt) 
 		error("SYNTAX ERROR");
+	symbol = internSymbol(varName);
 	exp = parseExp(scanner);
 }
 
+StatementType LET_Sta::getType() {
+	return LET_STATEMENT;
+}
+
+Statement *LET_Sta::clone() {
+	return new LET_Sta(varName, exp->clone());
+}
+
+string LET_Sta::getVarName() {
+	return varName;
+}
+
+Expression *LET_Sta::getExp() {
+	return exp;
+}
+
+void LET_Sta::setExp(Expression *exp) {
+	this->exp = exp;
+}
+
 /*
  * Implementation notes: the PRINT_Sta subclass
  * ----------------------------------------------
@@ -64,43 +91,67 @@ PRINT_Sta::~PRINT_Sta() {
 }
 
 void PRINT_Sta::execute(EvalState &state) {
-	cout << exp->eval(state) << endl;
+	OutputSink &out = state.getOutput();
+	out.writeInt(exp->eval(state));
+	out.endLine();
 }
 
 void PRINT_Sta::parseSta(TokenScanner &scanner) {
-	try {
-		exp = parseExp(scanner);
-	}
-	catch (...) {
-		error("SYNTAX ERROR");
-	}
+	exp = tryParseExp(scanner);
+	if (exp == nullptr) error("SYNTAX ERROR");
+}
+
+StatementType PRINT_Sta::getType() {
+	return PRINT_STATEMENT;
+}
+
+Statement *PRINT_Sta::clone() {
+	return new PRINT_Sta(exp->clone());
+}
+
+Expression *PRINT_Sta::getExp() {
+	return exp;
 }
+
+void PRINT_Sta::setExp(Expression *exp) {
+	this->exp = exp;
+}
+
 /*
  * Implementation notes: the INPUT_Sta subclass
  * ----------------------------------------------
  * The INPUT_Sta subclass declares Statement for requiring input of a variable.
+ * At the end of the input the answer is empty, which reads as 0, just as
+ * an empty line does.  On a suspendable state, the statement throws InputPending
+ * after the prompt when no line is ready, and does not repeat the prompt
+ * when the program resumes.
  */
 
-INPUT_Sta::INPUT_Sta(string varName) :varName(varName) {}
+INPUT_Sta::INPUT_Sta(string varName) :varName(varName), symbol(internSymbol(varName)) {}
 
 void INPUT_Sta::execute(EvalState &state) {
-	string str;
-	bool ok = false;
+	const char *line;
+	size_t length;
 	int value;
+	OutputSink &out = state.getOutput();
+	LineReader &input = state.getInput();
 	while (1) {
-		cout << " ? ";
-		getline(cin,str);
-		ok = true;
-		try {
-			value = stringToInteger(str);
+		if (!state.takePrompted()) {
+			out.write(" ? ");
+			out.flush();
+		}
+		if (state.isSuspendable() && !input.hasLine() && !input.isClosed()) {
+			state.setPrompted();
+			throw InputPending();
 		}
-		catch (...) {
-			ok = false;
+		if (!input.readLine(line, length)) {
+			line = "";
+			length = 0;
 		}
-		if (ok) break;
-		cout << "INVALID NUMBER\n";
+		if (parseInteger(line, length, value)) break;
+		out.writeLine("INVALID NUMBER");
 	}
-	state.setValue(varName, value);
+	state.setValue(symbol, value);
 }
 
 void INPUT_Sta::parseSta(TokenScanner &scanner) {
@@ -108,30 +159,51 @@ void INPUT_Sta::parseSta(TokenScanner &scanner) {
 	//cout << "input varName: " << varName << endl;
 	if(scanner.getTokenType(varName)!=WORD)
 		error("SYNTAX ERROR");
+	symbol = internSymbol(varName);
 }
+
+StatementType INPUT_Sta::getType() {
+	return INPUT_STATEMENT;
+}
+
+Statement *INPUT_Sta::clone() {
+	return new INPUT_Sta(varName);
+}
+
+string INPUT_Sta::getVarName() {
+	return varName;
+}
+
 /*
  * Implementation notes: the END_Sta subclass
  * ----------------------------------------------
- * The END_Sta subclass declares Statement for creating a tag stating the program 
- * has ended
+ * The END_Sta subclass declares Statement for telling the program that
+ * it has ended
  */
 
 void END_Sta::execute(EvalState &state) {
-	state.setValue("PROGRAM_END_TAG", 1);
+	state.requestEnd();
 }
 void END_Sta::parseSta(TokenScanner &scanner) {}
 
+StatementType END_Sta::getType() {
+	return END_STATEMENT;
+}
+
+Statement *END_Sta::clone() {
+	return new END_Sta;
+}
+
 /*
  * Implementation notes: the GOTO_Sta subclass
  * ----------------------------------------------
  * The GOTO_Sta subclass declares Statement for excuting the program from a given
- * line,by creating a GOTO_TAG
+ * line,by requesting a jump from the program
  */
 GOTO_Sta::GOTO_Sta(int lineNumber) :lineNumber(lineNumber) {}
 
 void GOTO_Sta::execute(EvalState &state) {
-	state.setValue("GOTO_TAG", lineNumber);
-	state.setValue("GOTO_DONE", 0);
+	state.requestJump(lineNumber);
 }
 
 void GOTO_Sta::parseSta(TokenScanner &scanner) {
@@ -139,6 +211,18 @@ void GOTO_Sta::parseSta(TokenScanner &scanner) {
 	if (scanner.getTokenType(num) != NUMBER) error("SYNTAX ERROR");
 	lineNumber = stringToInteger(num);
 }
+
+StatementType GOTO_Sta::getType() {
+	return GOTO_STATEMENT;
+}
+
+Statement *GOTO_Sta::clone() {
+	return new GOTO_Sta(lineNumber);
+}
+
+int GOTO_Sta::getLineNumber() {
+	return lineNumber;
+}
 /*
  * Implementation notes: the IF_Sta subclass
  * ----------------------------------------------
@@ -154,10 +238,8 @@ IF_Sta::~IF_Sta() {
 
 void IF_Sta::execute(EvalState &state) {
 	int l = lhs->eval(state), r = rhs->eval(state);
-	if ((op == '=' && l == r) || (op == '<' && l < r) || (op == '>' && l > r)) {
-		state.setValue("GOTO_TAG", lineNumber);
-		state.setValue("GOTO_DONE", 0);
-	}
+	if ((op == '=' && l == r) || (op == '<' && l < r) || (op == '>' && l > r))
+		state.requestJump(lineNumber);
 }
 
 void IF_Sta::parseSta(TokenScanner &scanner) {
@@ -172,16 +254,12 @@ void IF_Sta::parseSta(TokenScanner &scanner) {
 		if (scanner.getTokenType(nxt) == EOF) error("SYNTAX ERROR");
 	} while (1);
 	//cout << "if left: " << left << endl;
-	try {
-		TokenScanner temp;
-		temp.ignoreWhitespace();
-		temp.scanNumbers();
-		temp.setInput(left);
-		lhs = parseExp(temp);
-	}
-	catch (...) {
-		error("SYNTAX ERROR");
-	}
+	TokenScanner leftScanner;
+	leftScanner.ignoreWhitespace();
+	leftScanner.scanNumbers();
+	leftScanner.setInput(left);
+	lhs = tryParseExp(leftScanner);
+	if (lhs == nullptr) error("SYNTAX ERROR");
 	op = scanner.nextToken()[0];
 	string right = "";
 	do {
@@ -192,34 +270,63 @@ void IF_Sta::parseSta(TokenScanner &scanner) {
 		if (scanner.getTokenType(nxt) == EOF) error("SYNTAX ERROR");
 	} while (1);
 	//cout << "if right: " << right << endl;
-	try {
-		TokenScanner temp;
-		temp.ignoreWhitespace();
-		temp.scanNumbers();
-		temp.setInput(right);
-		rhs = parseExp(temp);
-	}
-	catch (...) {
-		error("SYNTAX ERROR");
-	}
+	TokenScanner rightScanner;
+	rightScanner.ignoreWhitespace();
+	rightScanner.scanNumbers();
+	rightScanner.setInput(right);
+	rhs = tryParseExp(rightScanner);
+	if (rhs == nullptr) error("SYNTAX ERROR");
 	string num = scanner.nextToken();
 	if (scanner.getTokenType(num) == NUMBER)
 		lineNumber = stringToInteger(num);
 	else 
 		error("SYNTAX ERROR");
 }
+
+StatementType IF_Sta::getType() {
+	return IF_STATEMENT;
+}
+
+Statement *IF_Sta::clone() {
+	return new IF_Sta(op, lhs->clone(), rhs->clone(), lineNumber);
+}
+
+int IF_Sta::getLineNumber() {
+	return lineNumber;
+}
+
+char IF_Sta::getOp() {
+	return op;
+}
+
+Expression *IF_Sta::getLHS() {
+	return lhs;
+}
+
+Expression *IF_Sta::getRHS() {
+	return rhs;
+}
+
+void IF_Sta::setLHS(Expression *lhs) {
+	this->lhs = lhs;
+}
+
+void IF_Sta::setRHS(Expression *rhs) {
+	this->rhs = rhs;
+}
 /*
  * Implementation notes: getStatement
  * ------------------------------
- * This code just reads a statement.
+ * This code just reads a statement.  It keeps no state of its own, so
+ * lines can be parsed on several threads at once.
  */
 
 Statement *getStatement(TokenScanner &scanner) {
 	static const int SIZE = 7;
-	static string Types[SIZE] = { "REM","LET","PRINT","INPUT","GOTO","IF","END" };
+	static const char *const Types[SIZE] = { "REM","LET","PRINT","INPUT","GOTO","IF","END" };
 	string type = scanner.nextToken();
 	int id = 0;
-	while (Types[id] != type && id < SIZE) id++;
+	while (id < SIZE && type != Types[id]) id++;
 	Statement *stmt = nullptr;
 	switch (id){
 		case 0: break;
@@ -232,8 +339,13 @@ Statement *getStatement(TokenScanner &scanner) {
 		default:
 			error("SYNTAX ERROR");
 	}
-	if (stmt != nullptr) stmt->parseSta(scanner);
-	//stmt->execute(EvalState());
-	if (id!=0 && scanner.hasMoreTokens()) error("SYNTAX ERROR");
+	try {
+		if (stmt != nullptr) stmt->parseSta(scanner);
+		//stmt->execute(EvalState());
+		if (id!=0 && scanner.hasMoreTokens()) error("SYNTAX ERROR");
+	} catch (...) {
+		delete stmt;
+		throw;
+	}
 	return stmt;
 }
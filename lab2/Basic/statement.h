@@ -12,9 +12,24 @@
 #ifndef _statement_h
 #define _statement_h
 
+#include <string>
 #include "evalstate.h"
 #include "exp.h"
 #include "../StanfordCPPLib/tokenscanner.h"
+using namespace std;
+
+/*
+ * Type: StatementType
+ * -------------------
+ * This enumerated type is used to differentiate the statement types that
+ * can be stored in a program.  REM lines have no parsed representation
+ * and therefore no type.
+ */
+
+enum StatementType {
+   LET_STATEMENT, PRINT_STATEMENT, INPUT_STATEMENT,
+   END_STATEMENT, GOTO_STATEMENT, IF_STATEMENT
+};
 
 /*
  * Class: Statement
@@ -70,6 +85,27 @@ public:
  * whitespace and to scan numbers.
  */
    virtual void parseSta(TokenScanner &scanner) = 0;
+
+/*
+ * Method: getType
+ * Usage: StatementType type = stmt->getType();
+ * --------------------------------------------
+ * Returns the type of the statement, which is used by the program
+ * analyses to find the statements that transfer control.
+ */
+
+   virtual StatementType getType() = 0;
+
+/*
+ * Method: clone
+ * Usage: Statement *copy = stmt->clone();
+ * ---------------------------------------
+ * Returns a deep copy of this statement, which the caller must free.
+ * The program runs optimized copies so that the parsed lines it keeps
+ * are never changed by the optimizer.
+ */
+
+   virtual Statement *clone() = 0;
 };
 
 /*
@@ -88,6 +124,7 @@ public:
 	 */
 	LET_Sta() = default;
 	LET_Sta(string varName,Expression *exp);
+	~LET_Sta();
 
 	/*
 	 * Prototypes for the virtual methods
@@ -97,9 +134,22 @@ public:
 	 */
 	virtual void execute(EvalState & state);
 	virtual void parseSta(TokenScanner &scanner);
+	virtual StatementType getType();
+	virtual Statement *clone();
+
+	/*
+	 * Methods: getVarName, getExp, setExp
+	 * -----------------------------------
+	 * Give the optimizer access to the parts of the statement.  setExp
+	 * does not free the expression it replaces.
+	 */
+	string getVarName();
+	Expression *getExp();
+	void setExp(Expression *exp);
 private:
 	string varName;
-	Expression *exp;
+	int symbol = -1;
+	Expression *exp = nullptr;
 };
 
 /*
@@ -126,10 +176,30 @@ public:
 	virtual ~PRINT_Sta();
 	virtual void execute(EvalState & state);
 	virtual void parseSta(TokenScanner &scanner);
+	virtual StatementType getType();
+	virtual Statement *clone();
+
+	/*
+	 * Methods: getExp, setExp
+	 * -----------------------
+	 * Give the optimizer access to the printed expression.  setExp does
+	 * not free the expression it replaces.
+	 */
+	Expression *getExp();
+	void setExp(Expression *exp);
 private:
-	Expression *exp;
+	Expression *exp = nullptr;
 };
 
+/*
+ * Class: InputPending
+ * -------------------
+ * The exception INPUT throws on a suspendable state when no line is
+ * ready.  Program::run catches it and keeps its place, so that resume
+ * can run the INPUT again once the line has arrived.
+ */
+class InputPending {};
+
 /*
  * Class: INPUT_Sta
  * ------------------
@@ -153,8 +223,19 @@ public:
 	 */
 	virtual void execute(EvalState & state);
 	virtual void parseSta(TokenScanner &scanner);
+	virtual StatementType getType();
+	virtual Statement *clone();
+
+	/*
+	 * Method: getVarName
+	 * Usage: string var = ((INPUT_Sta *) stmt)->getVarName();
+	 * -------------------------------------------------------
+	 * Returns the name of the variable read by this statement.
+	 */
+	string getVarName();
 private:
 	string varName;
+	int symbol = -1;
 };
 
 /*
@@ -179,6 +260,8 @@ public:
 	 */
 	virtual void execute(EvalState & state);
 	virtual void parseSta(TokenScanner &scanner);
+	virtual StatementType getType();
+	virtual Statement *clone();
 };
 
 /*
@@ -204,6 +287,16 @@ public:
 	 */
 	virtual void execute(EvalState & state);
 	virtual void parseSta(TokenScanner &scanner);
+	virtual StatementType getType();
+	virtual Statement *clone();
+
+	/*
+	 * Method: getLineNumber
+	 * Usage: int target = ((GOTO_Sta *) stmt)->getLineNumber();
+	 * ---------------------------------------------------------
+	 * Returns the line number this statement jumps to.
+	 */
+	int getLineNumber();
 private:
 	int lineNumber;
 };
@@ -233,8 +326,31 @@ public:
 	 */
 	virtual void execute(EvalState & state);
 	virtual void parseSta(TokenScanner &scanner);
+	virtual StatementType getType();
+	virtual Statement *clone();
+
+	/*
+	 * Method: getLineNumber
+	 * Usage: int target = ((IF_Sta *) stmt)->getLineNumber();
+	 * -------------------------------------------------------
+	 * Returns the line number this statement jumps to when the
+	 * condition holds.
+	 */
+	int getLineNumber();
+
+	/*
+	 * Methods: getOp, getLHS, getRHS, setLHS, setRHS
+	 * ----------------------------------------------
+	 * Give the optimizer access to the condition.  The setters do not
+	 * free the expressions they replace.
+	 */
+	char getOp();
+	Expression *getLHS();
+	Expression *getRHS();
+	void setLHS(Expression *lhs);
+	void setRHS(Expression *rhs);
 private:
-	Expression *lhs, *rhs;
+	Expression *lhs = nullptr, *rhs = nullptr;
 	char op;
 	int lineNumber;
 };
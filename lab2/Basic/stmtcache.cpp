@@ -0,0 +1,66 @@
+/*
+ * File: stmtcache.cpp
+ * -------------------
+ * This file implements the stmtcache.h interface.
+ */
+
+#include <string>
+#include "stmtcache.h"
+using namespace std;
+
+StatementCache::StatementCache(int capacity) {
+	this->capacity = capacity < 1 ? 1 : capacity;
+	hits = misses = evictions = 0;
+}
+
+StatementCache::~StatementCache() {
+	clear();
+}
+
+/*
+ * Implementation notes: lookup, insert
+ * ------------------------------------
+ * The entries are kept in a list from the most to the least recently
+ * used one, and the index maps each line to its place in the list, so
+ * that a hit only has to splice its entry to the front.
+ */
+
+Statement *StatementCache::lookup(const string & line) {
+	auto it = index.find(line);
+	if (it == index.end()) {
+		misses++;
+		return nullptr;
+	}
+	hits++;
+	entries.splice(entries.begin(), entries, it->second);
+	return it->second->second;
+}
+
+void StatementCache::insert(const string & line, Statement *stmt) {
+	if (entries.size() >= capacity) {
+		index.erase(entries.back().first);
+		delete entries.back().second;
+		entries.pop_back();
+		evictions++;
+	}
+	entries.push_front(make_pair(line, stmt));
+	index[line] = entries.begin();
+}
+
+void StatementCache::clear() {
+	for (auto it = entries.begin(); it != entries.end(); it++) delete it->second;
+	entries.clear();
+	index.clear();
+}
+
+long long StatementCache::getHits() {
+	return hits;
+}
+
+long long StatementCache::getMisses() {
+	return misses;
+}
+
+long long StatementCache::getEvictions() {
+	return evictions;
+}
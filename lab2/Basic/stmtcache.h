@@ -0,0 +1,117 @@
+/*
+ * File: stmtcache.h
+ * -----------------
+ * This interface exports the StatementCache class, which keeps the
+ * statements parsed from recent immediate-mode commands so that a
+ * command typed again is run without being scanned and parsed again.
+ */
+
+#ifndef _stmtcache_h
+#define _stmtcache_h
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "statement.h"
+
+/*
+ * Class: StatementCache
+ * ---------------------
+ * A bounded cache from the exact text of a command line to the
+ * statement parsed from it, which drops the least recently used entry
+ * when it is full.  The cache owns the statements it holds.
+ *
+ * Parsing a statement depends on its text and on the symbol table it
+ * was parsed with (see SymbolTable in evalstate.h): the ids of the
+ * names it refers to belong to that table and are freed with it.  A
+ * cached statement is therefore only valid on that table, and a cache
+ * must not outlive it or be shared by sessions with different tables;
+ * Session keeps its cache next to its own table.  The inline caches in
+ * its expressions check the version of the state they read, so a cached
+ * statement stays valid across CLEAR.  Should parsing ever come to
+ * depend on the state, the client must call clear whenever that state
+ * changes.
+ */
+
+class StatementCache {
+
+public:
+
+/*
+ * Constructor: StatementCache
+ * Usage: StatementCache cache;
+ *        StatementCache cache(capacity);
+ * --------------------------------------
+ * Creates an empty cache that holds at most capacity statements.
+ */
+
+   StatementCache(int capacity = 256);
+
+/*
+ * Destructor: ~StatementCache
+ * Usage: usually implicit
+ * -----------------------
+ * Frees the cached statements.
+ */
+
+   ~StatementCache();
+
+/*
+ * Method: lookup
+ * Usage: Statement *stmt = cache.lookup(line);
+ * --------------------------------------------
+ * Returns the statement cached for line and marks it as the most
+ * recently used one, or returns nullptr if there is none.  The
+ * statement stays owned by the cache.
+ */
+
+   Statement *lookup(const std::string & line);
+
+/*
+ * Method: insert
+ * Usage: cache.insert(line, stmt);
+ * --------------------------------
+ * Adds the statement parsed from line, which must not be cached yet,
+ * and takes ownership of it.  The least recently used statement is
+ * freed if the cache is full.
+ */
+
+   void insert(const std::string & line, Statement *stmt);
+
+/*
+ * Method: clear
+ * Usage: cache.clear();
+ * ---------------------
+ * Frees every cached statement.  The statistics are kept.
+ */
+
+   void clear();
+
+/*
+ * Methods: getHits, getMisses, getEvictions
+ * Usage: long long n = cache.getHits();
+ * -------------------------------------
+ * Return the number of lookups that found a statement, the number
+ * that did not and the number of statements dropped to make room.
+ */
+
+   long long getHits();
+   long long getMisses();
+   long long getEvictions();
+
+private:
+
+   typedef std::list<std::pair<std::string, Statement *> > EntryList;
+
+   EntryList entries;
+   std::unordered_map<std::string, EntryList::iterator> index;
+   size_t capacity;
+   long long hits, misses, evictions;
+
+   StatementCache(const StatementCache &);
+   StatementCache & operator=(const StatementCache &);
+
+};
+
+#endif
@@ -5,6 +5,7 @@
  */
 
 #include <cctype>
+#include <climits>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -17,26 +18,116 @@ using namespace std;
 /*
  * Implementation notes: numeric conversion
  * ----------------------------------------
- * These functions use the <sstream> library to perform the conversion.
+ * The real-valued functions use the <sstream> library to perform the
+ * conversion.  The integer functions are wrappers around formatInteger
+ * and parseInteger, which work directly on character buffers.
  */
 
 string integerToString(int n) {
-   ostringstream stream;
-   stream << n;
-   return stream.str();
+   char buffer[MAX_INTEGER_LENGTH];
+   return string(buffer, formatInteger(n, buffer));
 }
 
 int stringToInteger(string str) {
-   istringstream stream(str);
    int value;
-   stream >> value >> ws;
-   if (!stream.eof()) {
+   if (!parseInteger(str.data(), str.length(), value)) {
       error("stringToInteger: Illegal integer format (" + str + ")");
    }
-   
    return value;
 }
 
+/*
+ * Implementation notes: formatInteger
+ * -----------------------------------
+ * The digits are produced two at a time from a table of the pairs 00
+ * through 99, writing backward from the end of a scratch buffer, so
+ * that a ten-digit number costs five divisions.  The magnitude is taken
+ * as unsigned so that the smallest integer needs no special case.
+ */
+
+static const char DIGIT_PAIRS[] =
+   "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+   "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+   "8081828384858687888990919293949596979899";
+
+int formatInteger(int n, char *buffer) {
+   char scratch[MAX_INTEGER_LENGTH];
+   char *end = scratch + MAX_INTEGER_LENGTH;
+   char *p = end;
+   unsigned magnitude = (n < 0) ? 0u - (unsigned) n : (unsigned) n;
+   while (magnitude >= 100) {
+      const char *pair = DIGIT_PAIRS + 2 * (magnitude % 100);
+      magnitude /= 100;
+      *--p = pair[1];
+      *--p = pair[0];
+   }
+   if (magnitude >= 10) {
+      const char *pair = DIGIT_PAIRS + 2 * magnitude;
+      *--p = pair[1];
+      *--p = pair[0];
+   } else {
+      *--p = (char) ('0' + magnitude);
+   }
+   if (n < 0) *--p = '-';
+   int length = end - p;
+   for (int i = 0; i < length; i++) {
+      buffer[i] = p[i];
+   }
+   return length;
+}
+
+/*
+ * Implementation notes: parseInteger
+ * ----------------------------------
+ * The rules are those of the stream extraction that stringToInteger
+ * used to perform, including its corner cases:
+ *
+ *  - Leading whitespace is skipped, then an optional sign is read,
+ *    then the digits.  A string that ends before any digit, such as an
+ *    empty string or a lone sign, is accepted with the value 0.
+ *  - After the digits only whitespace may follow.
+ *  - A value out of range is clamped to INT_MIN or INT_MAX, and is only
+ *    accepted when the digits end the string, since the failed stream
+ *    would not skip the whitespace after them.
+ *
+ * The digits are accumulated in an unsigned long long with a sticky
+ * overflow flag, so the loop has no branch other than the digit test.
+ */
+
+static bool isBlank(char ch) {
+   return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+bool parseInteger(const char *str, size_t length, int & n) {
+   const char *p = str;
+   const char *end = str + length;
+   while (p < end && isBlank(*p)) p++;
+   bool negative = false;
+   if (p < end && (*p == '+' || *p == '-')) {
+      negative = (*p == '-');
+      p++;
+   }
+   const char *digits = p;
+   unsigned long long magnitude = 0;
+   bool overflow = false;
+   while (p < end && (unsigned) (*p - '0') < 10) {
+      magnitude = magnitude * 10 + (unsigned) (*p - '0');
+      overflow |= (magnitude > 2147483648ULL);
+      p++;
+   }
+   if (p == digits) {
+      n = 0;
+      return p == end;
+   }
+   if (overflow || magnitude > (negative ? 2147483648ULL : 2147483647ULL)) {
+      n = negative ? INT_MIN : INT_MAX;
+      return p == end;
+   }
+   while (p < end && isBlank(*p)) p++;
+   n = negative ? (int) (0u - (unsigned) magnitude) : (int) magnitude;
+   return p == end;
+}
+
 string realToString(double d) {
    ostringstream stream;
    stream << uppercase << d;
@@ -34,6 +34,41 @@ std::string integerToString(int n);
 
 int stringToInteger(std::string str);
 
+/*
+ * Constant: MAX_INTEGER_LENGTH
+ * ----------------------------
+ * The largest number of characters <code>formatInteger</code> writes.
+ */
+
+const int MAX_INTEGER_LENGTH = 11;
+
+/*
+ * Function: formatInteger
+ * Usage: int length = formatInteger(n, buffer);
+ * ---------------------------------------------
+ * Writes the decimal digits of <code>n</code>, preceded by a minus sign
+ * if <code>n</code> is negative, into <code>buffer</code> and returns the
+ * number of characters written.  The buffer must have room for
+ * <code>MAX_INTEGER_LENGTH</code> characters; no null character is
+ * added.  Unlike <code>integerToString</code>, this function allocates
+ * nothing and does not depend on the locale.
+ */
+
+int formatInteger(int n, char *buffer);
+
+/*
+ * Function: parseInteger
+ * Usage: if (parseInteger(str, length, n)) . . .
+ * -----------------------------------------------
+ * Converts the <code>length</code> characters at <code>str</code> into
+ * an integer exactly as <code>stringToInteger</code> does, storing the
+ * result in <code>n</code>.  Instead of calling <code>error</code>, it
+ * returns <code>false</code> when <code>stringToInteger</code> would
+ * report an illegal format.  The function allocates nothing.
+ */
+
+bool parseInteger(const char *str, size_t length, int & n);
+
 /*
  * Function: realToString
  * Usage: string s = realToString(d);
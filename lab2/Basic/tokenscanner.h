@@ -322,6 +322,8 @@ private:
 
    std::string buffer;              /* The original argument string */
    std::istream *isp;               /* The input stream for tokens  */
+   size_t cursor;                   /* Next character of the buffer */
+   bool failed;                     /* Buffer has been read past end */
    bool stringInputFlag;            /* Flag indicating string input */
    bool ignoreWhitespaceFlag;       /* Scanner ignores whitespace   */
    bool ignoreCommentsFlag;         /* Scanner ignores comments     */
@@ -334,12 +336,18 @@ private:
 /* Private method prototypes */
 
    void initScanner();
+   int readChar();
+   void unreadChar();
    void skipSpaces();
    std::string scanWord();
    std::string scanNumber();
    std::string scanString();
    bool isOperator(std::string op);
    bool isOperatorPrefix(std::string op);
+   void freeCells(StringCell *& list);
+
+   TokenScanner(const TokenScanner &);
+   TokenScanner & operator=(const TokenScanner &);
 
 };
 
@@ -28,20 +28,31 @@ TokenScanner::TokenScanner(istream & infile) {
 }
 
 TokenScanner::~TokenScanner() {
-   if (stringInputFlag) delete isp;
+   freeCells(savedTokens);
+   freeCells(operators);
 }
 
+/*
+ * Implementation notes: setInput
+ * ------------------------------
+ * String input is read straight out of the buffer rather than through
+ * an istringstream, which is much more expensive to create than the
+ * handful of tokens on a typical line is to scan.
+ */
+
 void TokenScanner::setInput(string str) {
    stringInputFlag = true;
-   buffer = str;
-   isp = new istringstream(buffer);
-   savedTokens = NULL;
+   buffer.swap(str);
+   isp = NULL;
+   cursor = 0;
+   failed = false;
+   freeCells(savedTokens);
 }
 
 void TokenScanner::setInput(istream & infile) {
    stringInputFlag = false;
    isp = &infile;
-   savedTokens = NULL;
+   freeCells(savedTokens);
 }
 
 bool TokenScanner::hasMoreTokens() {
@@ -60,48 +71,48 @@ string TokenScanner::nextToken() {
    }
    while (true) {
       if (ignoreWhitespaceFlag) skipSpaces();
-      int ch = isp->get();
+      int ch = readChar();
       if (ch == '/' && ignoreCommentsFlag) {
-         ch = isp->get();
+         ch = readChar();
          if (ch == '/') {
             while (true) {
-               ch = isp->get();
+               ch = readChar();
                if (ch == '\n' || ch == '\r' || ch == EOF) break;
             }
             continue;
          } else if (ch == '*') {
             int prev = EOF;
             while (true) {
-               ch = isp->get();
+               ch = readChar();
                if (ch == EOF || (prev == '*' && ch == '/')) break;
                prev = ch;
             }
             continue;
          }
-         if (ch != EOF) isp->unget();
+         if (ch != EOF) unreadChar();
          ch = '/';
       }
       if (ch == EOF) return "";
       if ((ch == '"' || ch == '\'') && scanStringsFlag) {
-         isp->unget();
+         unreadChar();
          return scanString();
       }
       if (isdigit(ch) && scanNumbersFlag) {
-         isp->unget();
+         unreadChar();
          return scanNumber();
       }
       if (isWordCharacter(ch)) {
-         isp->unget();
+         unreadChar();
          return scanWord();
       }
       string op = string(1, ch);
       while (isOperatorPrefix(op)) {
-         ch = isp->get();
+         ch = readChar();
          if (ch == EOF) break;
          op += ch;
       }
       while (op.length() > 1 && !isOperator(op)) {
-         isp->unget();
+         unreadChar();
          op.erase(op.length() - 1, 1);
       }
       return op;
@@ -143,10 +154,11 @@ void TokenScanner::addOperator(string op) {
 }
 
 int TokenScanner::getPosition() const {
+   int position = stringInputFlag ? (failed ? -1 : int(cursor)) : int(isp->tellg());
    if (savedTokens == NULL) {
-      return int(isp->tellg());
+      return position;
    } else {
-      return int(isp->tellg()) - savedTokens->str.length();
+      return position - savedTokens->str.length();
    }
    return -1;
 }
@@ -230,11 +242,11 @@ string TokenScanner::getStringValue(string token) const {
 }
 
 int TokenScanner::getChar() {
-   return isp->get();
+   return readChar();
 }
 
 void TokenScanner::ungetChar(int ch) {
-   isp->unget();
+   unreadChar();
 }
 
 /* Private methods */
@@ -244,9 +256,51 @@ void TokenScanner::initScanner() {
    ignoreCommentsFlag = false;
    scanNumbersFlag = false;
    scanStringsFlag = false;
+   savedTokens = NULL;
    operators = NULL;
 }
 
+/*
+ * Implementation notes: freeCells
+ * -------------------------------
+ * The scanner owns the cells of both lists.  A token saved by
+ * hasMoreTokens is often never read again, so the stack is freed on
+ * every setInput and when the scanner is destroyed.
+ */
+
+void TokenScanner::freeCells(StringCell *& list) {
+   while (list != NULL) {
+      StringCell *cp = list;
+      list = cp->link;
+      delete cp;
+   }
+}
+
+/*
+ * Implementation notes: readChar, unreadChar
+ * ------------------------------------------
+ * For string input, these methods behave exactly like get and unget on
+ * an istringstream: once a read has hit the end of the string, every
+ * later read returns EOF and unreadChar has no effect.
+ */
+
+int TokenScanner::readChar() {
+   if (!stringInputFlag) return isp->get();
+   if (failed || cursor >= buffer.length()) {
+      failed = true;
+      return EOF;
+   }
+   return (unsigned char) buffer[cursor++];
+}
+
+void TokenScanner::unreadChar() {
+   if (!stringInputFlag) {
+      isp->unget();
+   } else if (!failed && cursor > 0) {
+      cursor--;
+   }
+}
+
 /*
  * Implementation notes: skipSpaces
  * --------------------------------
@@ -256,10 +310,10 @@ void TokenScanner::initScanner() {
 
 void TokenScanner::skipSpaces() {
    while (true) {
-      int ch = isp->get();
+      int ch = readChar();
       if (ch == EOF) return;
       if (!isspace(ch)) {
-         isp->unget();
+         unreadChar();
          return;
       }
    }
@@ -275,10 +329,10 @@ void TokenScanner::skipSpaces() {
 string TokenScanner::scanWord() {
    string token = "";
    while (true) {
-      int ch = isp->get();
+      int ch = readChar();
       if (ch == EOF) break;
       if (!isWordCharacter(ch)) {
-         isp->unget();
+         unreadChar();
          break;
       }
       token += char(ch);
@@ -300,7 +354,7 @@ string TokenScanner::scanNumber() {
    string token = "";
    NumberScannerState state = INITIAL_STATE;
    while (state != FINAL_STATE) {
-      int ch = isp->get();
+      int ch = readChar();
       int xch = 'e';
       switch (state) {
        case INITIAL_STATE:
@@ -316,7 +370,7 @@ string TokenScanner::scanNumber() {
             state = STARTING_EXPONENT;
             xch = ch;
          } else if (!isdigit(ch)) {
-            if (ch != EOF) isp->unget();
+            if (ch != EOF) unreadChar();
             state = FINAL_STATE;
          }
          break;
@@ -325,7 +379,7 @@ string TokenScanner::scanNumber() {
             state = STARTING_EXPONENT;
             xch = ch;
          } else if (!isdigit(ch)) {
-            if (ch != EOF) isp->unget();
+            if (ch != EOF) unreadChar();
             state = FINAL_STATE;
          }
          break;
@@ -335,8 +389,8 @@ string TokenScanner::scanNumber() {
          } else if (isdigit(ch)) {
             state = SCANNING_EXPONENT;
          } else {
-            if (ch != EOF) isp->unget();
-            isp->unget();
+            if (ch != EOF) unreadChar();
+            unreadChar();
             state = FINAL_STATE;
          }
          break;
@@ -344,15 +398,15 @@ string TokenScanner::scanNumber() {
          if (isdigit(ch)) {
             state = SCANNING_EXPONENT;
          } else {
-            if (ch != EOF) isp->unget();
-            isp->unget();
-            isp->unget();
+            if (ch != EOF) unreadChar();
+            unreadChar();
+            unreadChar();
             state = FINAL_STATE;
          }
          break;
        case SCANNING_EXPONENT:
          if (!isdigit(ch)) {
-            if (ch != EOF) isp->unget();
+            if (ch != EOF) unreadChar();
             state = FINAL_STATE;
          }
          break;
@@ -377,11 +431,11 @@ string TokenScanner::scanNumber() {
 
 string TokenScanner::scanString() {
    string token = "";
-   char delim = isp->get();
+   char delim = readChar();
    token += delim;
    bool escape = false;
    while (true) {
-      int ch = isp->get();
+      int ch = readChar();
       if (ch == EOF) error("TokenScanner found unterminated string");
       if (ch == delim && !escape) break;
       escape = (ch == '\\') && !escape;
@@ -0,0 +1,226 @@
+/*
+ * File: server_test.cpp
+ * ---------------------
+ * Checks the server mode of the interpreter from the side of its
+ * clients: sessions are answered, a program waiting at INPUT, a loop
+ * that never ends and a client that never reads hold up no one else,
+ * SAVE and LOAD stay off without an image directory, and many idle
+ * clients cost no answers.  The server runs in this process on a
+ * single worker, which is where one session blocking another would
+ * show.  Build and run it with "make check" from the top directory.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.h"
+using namespace std;
+
+static const int TIMEOUT = 5000;
+
+static int failures = 0;
+
+static void check(bool ok, const string & what) {
+   if (!ok) {
+      cout << "FAIL: " << what << endl;
+      failures++;
+   }
+}
+
+static void checkEqual(const string & actual, const string & expected, const string & what) {
+   if (actual != expected) {
+      cout << "FAIL: " << what << endl
+           << "--- expected ---" << endl << expected
+           << "--- actual ---" << endl << actual;
+      failures++;
+   }
+}
+
+/*
+ * Function: connectTo
+ * Usage: int fd = connectTo(path);
+ * --------------------------------
+ * Connects to the server at path, retrying while the server is still
+ * starting, and returns the socket, or -1 if there is no server.
+ */
+
+static int connectTo(const string & path) {
+   sockaddr_un address;
+   memset(&address, 0, sizeof address);
+   address.sun_family = AF_UNIX;
+   strncpy(address.sun_path, path.c_str(), sizeof address.sun_path - 1);
+   for (int attempt = 0; attempt < 200; attempt++) {
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd < 0) return -1;
+      if (connect(fd, (sockaddr *) &address, sizeof address) == 0) return fd;
+      close(fd);
+      this_thread::sleep_for(chrono::milliseconds(10));
+   }
+   return -1;
+}
+
+static void sendText(int fd, const string & text) {
+   size_t sent = 0;
+   while (sent < text.size()) {
+      ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return;
+      sent += n;
+   }
+}
+
+/*
+ * Function: receive
+ * Usage: string text = receive(fd, length);
+ * -----------------------------------------
+ * Reads from fd until length characters have come, the server closes
+ * the connection or nothing arrives for TIMEOUT milliseconds, and
+ * returns what was read.  A length of 0 reads to the end.
+ */
+
+static string receive(int fd, size_t length = 0) {
+   string text;
+   char buffer[4096];
+   while (length == 0 || text.size() < length) {
+      pollfd entry = { fd, POLLIN, 0 };
+      if (poll(&entry, 1, TIMEOUT) <= 0) break;
+      size_t wanted = sizeof buffer;
+      if (length != 0 && length - text.size() < wanted) wanted = length - text.size();
+      ssize_t n = recv(fd, buffer, wanted, 0);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      text.append(buffer, n);
+   }
+   return text;
+}
+
+/*
+ * Function: ask
+ * Usage: string answer = ask(path, lines, length);
+ * ------------------------------------------------
+ * Opens a new connection, sends the lines and returns the first length
+ * characters of the answer, or all of it if the lines end with QUIT.
+ */
+
+static string ask(const string & path, const string & lines, size_t length = 0) {
+   int fd = connectTo(path);
+   if (fd < 0) return "NO CONNECTION";
+   sendText(fd, lines);
+   string answer = receive(fd, length);
+   close(fd);
+   return answer;
+}
+
+static void testEcho(const string & path) {
+   checkEqual(ask(path, "10 LET x = 6\n20 PRINT x * 7\nRUN\nLIST 20\nQUIT\n"),
+              "42\nSYNTAX ERROR\n", "a session is answered and ends at QUIT");
+   checkEqual(ask(path, "PRINT 1 / 0\nFOO\nQUIT\n"), "DIVIDE BY ZERO\nSYNTAX ERROR\n",
+              "errors are sent to the client");
+}
+
+static void testWaitingInput(const string & path) {
+   int waiting = connectTo(path);
+   sendText(waiting, "10 INPUT x\n20 PRINT x + 1\nRUN\n");
+   checkEqual(receive(waiting, 3), " ? ", "prompt of a waiting INPUT");
+   checkEqual(ask(path, "PRINT 5\n", 2), "5\n", "a session answers while another waits at INPUT");
+   sendText(waiting, "7\nQUIT\n");
+   checkEqual(receive(waiting), "8\n", "the waiting session resumes");
+   close(waiting);
+}
+
+static void testEndlessLoop(const string & path) {
+   int looping = connectTo(path);
+   sendText(looping, "10 LET a = a + 1\n20 GOTO 10\nRUN\n");
+   this_thread::sleep_for(chrono::milliseconds(100));
+   for (int i = 0; i < 10; i++) {
+      string value = to_string(i);
+      checkEqual(ask(path, "PRINT " + value + "\n", value.size() + 1), value + "\n",
+                 "a session answers while another loops");
+   }
+   close(looping);
+}
+
+/*
+ * Function: testSilentClient
+ * --------------------------
+ * A client that sends a program which prints without end and never
+ * reads fills its socket; the worker must leave it rather than wait.
+ */
+
+static void testSilentClient(const string & path) {
+   int silent = connectTo(path);
+   sendText(silent, "10 PRINT 123456789\n20 GOTO 10\nRUN\n");
+   this_thread::sleep_for(chrono::milliseconds(200));
+   for (int i = 0; i < 10; i++) {
+      checkEqual(ask(path, "PRINT 3 * 3\n", 2), "9\n", "a session answers while another is not read");
+   }
+   string sample = receive(silent, 100);
+   check(sample.size() == 100 && sample.substr(0, 10) == "123456789\n",
+         "the unread output is still delivered");
+   close(silent);
+}
+
+static void testImagesDisabled(const string & path) {
+   checkEqual(ask(path, "10 PRINT 1\nSAVE x.img\nLOAD x.img\nQUIT\n"),
+              "SAVE AND LOAD ARE DISABLED\nSAVE AND LOAD ARE DISABLED\n",
+              "SAVE and LOAD without an image directory");
+}
+
+static void testManyClients(const string & path) {
+   const int IDLE = 500, ACTIVE = 100;
+   vector<int> idle;
+   for (int i = 0; i < IDLE; i++) {
+      int fd = connectTo(path);
+      if (fd >= 0) idle.push_back(fd);
+   }
+   check(idle.size() == IDLE, "idle clients connect");
+   vector<int> active;
+   for (int i = 0; i < ACTIVE; i++) {
+      int fd = connectTo(path);
+      if (fd < 0) continue;
+      sendText(fd, "LET v = " + to_string(i) + "\nPRINT v * 2\nQUIT\n");
+      active.push_back(fd);
+   }
+   int answered = 0;
+   for (size_t i = 0; i < active.size(); i++) {
+      if (receive(active[i]) == to_string(2 * i) + "\n") answered++;
+      close(active[i]);
+   }
+   check(answered == ACTIVE, "active clients are answered among idle ones");
+   for (size_t i = 0; i < idle.size(); i++) close(idle[i]);
+}
+
+/*
+ * Implementation notes: main
+ * --------------------------
+ * The server thread never returns, so the test ends the process with
+ * _exit instead of returning from main, which would run destructors
+ * under the server.
+ */
+
+int main() {
+   string path = "/tmp/server_test." + to_string(getpid()) + ".sock";
+   ServerOptions options;
+   options.workers = 1;
+   options.slice = 10000;
+   options.stats = nullptr;
+   thread server([path, options]() { serveSessions(path, options); });
+   server.detach();
+   testEcho(path);
+   testWaitingInput(path);
+   testEndlessLoop(path);
+   testSilentClient(path);
+   testImagesDisabled(path);
+   testManyClients(path);
+   unlink(path.c_str());
+   cout << (failures == 0 ? "server_test: all passed" : "server_test: FAILED") << endl;
+   _exit(failures == 0 ? 0 : 1);
+}
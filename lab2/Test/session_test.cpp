@@ -0,0 +1,518 @@
+/*
+ * File: session_test.cpp
+ * ----------------------
+ * Checks the behaviour of the interpreter library that the traces of
+ * score.cc cannot reach: LIST ranges, INPUT that waits for its line,
+ * programs that run in slices, sessions on several threads, the symbol
+ * tables of sessions, the round trip of programs through SAVE and LOAD
+ * and the files the code cache deletes.  Build and run it with "make
+ * check" from the top directory.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "codecache.h"
+#include "session.h"
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string & what) {
+   if (!ok) {
+      cout << "FAIL: " << what << endl;
+      failures++;
+   }
+}
+
+static void checkEqual(const string & actual, const string & expected, const string & what) {
+   if (actual != expected) {
+      cout << "FAIL: " << what << endl
+           << "--- expected ---" << endl << expected
+           << "--- actual ---" << endl << actual;
+      failures++;
+   }
+}
+
+/*
+ * Function: runLines
+ * Usage: string out = runLines(lines);
+ * ------------------------------------
+ * Feeds the lines to a fresh session with processLine, so that INPUT
+ * finds the end of the input instead of the next command, and returns
+ * what the session printed.
+ */
+
+static string runLines(const vector<string> & lines) {
+   string out;
+   {
+      LineReader in((string()));
+      OutputSink sink(out);
+      Session session(in, sink);
+      for (size_t i = 0; i < lines.size(); i++) session.processLine(lines[i]);
+   }
+   return out;
+}
+
+/*
+ * Function: runScript
+ * Usage: string out = runScript(script, slice);
+ * ---------------------------------------------
+ * Runs a whole script through Session::run, which also answers INPUT
+ * from the script, and returns what the session printed.
+ */
+
+static string runScript(const string & script, long long slice = 0) {
+   string out;
+   {
+      LineReader in(script);
+      OutputSink sink(out);
+      Session session(in, sink);
+      session.setSlice(slice);
+      session.run();
+   }
+   return out;
+}
+
+static void testListRanges() {
+   string program = "10 PRINT 1\n20 PRINT 2\n30 PRINT 3\n40 PRINT 4\n";
+   checkEqual(runScript(program + "LIST\n"), program, "LIST");
+   checkEqual(runScript(program + "LIST 20-30\n"), "20 PRINT 2\n30 PRINT 3\n", "LIST a-b");
+   checkEqual(runScript(program + "LIST 30-\n"), "30 PRINT 3\n40 PRINT 4\n", "LIST a-");
+   checkEqual(runScript(program + "LIST -20\n"), "10 PRINT 1\n20 PRINT 2\n", "LIST -b");
+   checkEqual(runScript(program + "LIST 25-26\n"), "", "LIST of an empty range");
+   checkEqual(runScript(program + "LIST 20\nLIST 1-2-3\nLIST -\n"),
+              "SYNTAX ERROR\nSYNTAX ERROR\nSYNTAX ERROR\n", "LIST syntax errors");
+}
+
+/*
+ * Function: testParseErrors
+ * -------------------------
+ * A statement that fails to parse is freed before all of its parts are
+ * set, both on a program line and on a command.
+ */
+
+static void testParseErrors() {
+   string lines = "10 IF x THEN\n20 IF 1 < THEN 3\n30 PRINT\n40 LET 5 = 3\n"
+                  "PRINT\nLET 5 = 3\nIF 1 < 2 THEN 3\nLIST\n";
+   string errors;
+   for (int i = 0; i < 7; i++) errors += "SYNTAX ERROR\n";
+   checkEqual(runScript(lines), errors, "statements that fail to parse");
+}
+
+/*
+ * Function: testInputAtEnd
+ * ------------------------
+ * At the end of the input INPUT reads 0, as for an empty line, and the
+ * program goes on; an invalid number is asked again.
+ */
+
+static void testInputAtEnd() {
+   vector<string> lines;
+   lines.push_back("10 LET a = 1");
+   lines.push_back("20 INPUT a");
+   lines.push_back("30 PRINT a + 1");
+   lines.push_back("RUN");
+   lines.push_back("PRINT a");
+   checkEqual(runLines(lines), " ? 1\n0\n", "INPUT at the end of the input");
+   checkEqual(runScript("10 INPUT a\n20 PRINT a\nRUN\nx\n\n"), " ? INVALID NUMBER\n ? 0\n",
+              "INPUT of an invalid number and of an empty line");
+}
+
+/*
+ * Function: testSuspendedInput
+ * ----------------------------
+ * Feeds a suspendable session through a non-blocking pipe, a piece at
+ * a time, as the server does.
+ */
+
+static void testSuspendedInput() {
+   int fds[2];
+   if (pipe(fds) != 0) {
+      check(false, "pipe");
+      return;
+   }
+   fcntl(fds[0], F_SETFL, O_NONBLOCK);
+   string out;
+   {
+      LineReader in(fds[0]);
+      OutputSink sink(out);
+      Session session(in, sink);
+      session.setSuspendable(true);
+      session.processLine("10 INPUT x");
+      session.processLine("20 PRINT x * 2");
+      session.processLine("RUN");
+      sink.flush();
+      check(session.isWaiting(), "RUN waits at INPUT");
+      checkEqual(out, " ? ", "prompt of a waiting INPUT");
+      check(!in.receive() && !in.isClosed(), "empty non-blocking read keeps the input open");
+      if (write(fds[1], "2", 1) != 1) check(false, "write");
+      in.receive();
+      session.resume();
+      check(session.isWaiting(), "a partial line does not answer INPUT");
+      if (write(fds[1], "1\n", 2) != 2) check(false, "write");
+      in.receive();
+      session.resume();
+      sink.flush();
+      check(!session.isWaiting(), "the whole line answers INPUT");
+      checkEqual(out, " ? 42\n", "output of a resumed program");
+      session.processLine("INPUT y");
+      check(session.isWaiting(), "an INPUT command waits too");
+      close(fds[1]);
+      in.receive();
+      session.resume();
+      check(!session.isWaiting(), "the end of the input ends the wait");
+   }
+   close(fds[0]);
+}
+
+/*
+ * Function: testSlicing
+ * ---------------------
+ * A program that runs in small slices must print what it prints in
+ * one go, whether its loops are counted loops or not.
+ */
+
+static const char *const SLICED_PROGRAM =
+   "10 LET s = 0\n"
+   "20 LET i = 0\n"
+   "30 LET s = s + i\n"
+   "40 LET i = i + 1\n"
+   "50 IF i < 20000 THEN 30\n"
+   "60 PRINT s\n"
+   "70 LET j = 0\n"
+   "80 LET k = 0\n"
+   "90 GOTO 100\n"
+   "100 LET k = k + j\n"
+   "110 LET j = j + 1\n"
+   "120 IF j < 5000 THEN 90\n"
+   "130 PRINT k\n";
+
+static void testSlicing() {
+   string expected = runScript(string(SLICED_PROGRAM) + "RUN\n");
+   checkEqual(expected, "199990000\n12497500\n", "output of the unsliced program");
+   checkEqual(runScript(string(SLICED_PROGRAM) + "RUN\nRUN\n", 7), expected + expected,
+              "output of the program in slices of 7");
+   string out;
+   {
+      LineReader in((string()));
+      OutputSink sink(out);
+      Session session(in, sink);
+      session.setSlice(100);
+      istringstream program(SLICED_PROGRAM);
+      string line;
+      while (getline(program, line)) session.processLine(line);
+      session.processLine("RUN");
+      int slices = 1;
+      while (session.isRunnable()) {
+         session.resume();
+         slices++;
+      }
+      check(slices > 100, "a slice of 100 preempts a long run");
+      check(session.getState().getStatementCount() >= 80000, "statements are counted");
+      session.processLine("CLEAR");
+      session.processLine("10 PRINT 1");
+      session.processLine("RUN");
+      check(!session.isRunnable(), "a short run finishes in its first slice");
+   }
+   checkEqual(out, expected + "1\n", "output of a run driven by resume");
+}
+
+/*
+ * Function: testStatementCounts
+ * -----------------------------
+ * Counted loops are counted as if every statement of every pass ran,
+ * including the pass that leaves the loop and the passes that an empty
+ * loop skips.
+ */
+
+static long long countStatements(const string & program) {
+   string out;
+   LineReader in((string()));
+   OutputSink sink(out);
+   Session session(in, sink);
+   istringstream lines(program);
+   string line;
+   while (getline(lines, line)) session.processLine(line);
+   session.processLine("RUN");
+   return session.getState().getStatementCount();
+}
+
+static void testStatementCounts() {
+   check(countStatements("10 LET i = 0\n20 LET i = i + 1\n30 IF i < 1 THEN 20\n") == 3,
+         "a loop left after one pass");
+   check(countStatements("10 LET i = 0\n20 LET i = i + 1\n30 IF i < 1000 THEN 20\n") == 2001,
+         "an empty counted loop");
+   check(countStatements("5 LET s = 0\n10 LET i = 0\n20 LET s = s + i\n30 LET i = i + 1\n"
+                         "40 IF i < 100 THEN 20\n50 END\n") == 303,
+         "a counted loop with a body");
+}
+
+static string threadScript(int k) {
+   ostringstream s;
+   s << "10 INPUT n\n20 LET t = 0\n30 LET i = 0\n40 LET t = t + i * " << k % 13 << "\n"
+     << "50 LET i = i + 1\n60 IF i < n THEN 40\n70 PRINT t\n"
+     << "80 PRINT 7 / (k" << k % 5 << " - k" << k % 5 << ")\n90 END\n"
+     << "RUN\n" << 100 + k << "\nLIST 40-60\nLET k" << k << " = 3\nPRINT k" << k << " * 2\nFOO\n";
+   return s.str();
+}
+
+static void testThreads() {
+   const int SESSIONS = 400, THREADS = 4;
+   vector<string> expected(SESSIONS), actual(SESSIONS);
+   for (int k = 0; k < SESSIONS; k++) expected[k] = runScript(threadScript(k));
+   vector<thread> pool;
+   for (int t = 0; t < THREADS; t++) {
+      pool.push_back(thread([&actual, t]() {
+         for (int k = t; k < SESSIONS; k += THREADS) actual[k] = runScript(threadScript(k), 50);
+      }));
+   }
+   for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+   int mismatches = 0;
+   for (int k = 0; k < SESSIONS; k++) {
+      if (actual[k] != expected[k]) mismatches++;
+   }
+   check(mismatches == 0, "sessions on several threads print what they print alone");
+}
+
+static void testSymbolTables() {
+   string outA, outB;
+   LineReader inA((string())), inB((string()));
+   OutputSink sinkA(outA), sinkB(outB);
+   Session a(inA, sinkA), b(inB, sinkB);
+   a.processLine("LET p = 1");
+   b.processLine("LET q = 5");
+   a.processLine("LET q = 2");
+   b.processLine("LET p = 7");
+   a.processLine("PRINT p * 10 + q");
+   b.processLine("PRINT p * 10 + q");
+   sinkA.flush();
+   sinkB.flush();
+   checkEqual(outA, "12\n", "variables of the first session");
+   checkEqual(outB, "75\n", "variables of the second session");
+   for (int i = 0; i < 1000; i++) a.processLine("LET name" + to_string(i) + " = 1");
+   check(a.getSymbols().size() >= 1000, "names are interned in the session");
+   check(b.getSymbols().size() < 10, "sessions do not share names");
+}
+
+/*
+ * Implementation notes: random programs
+ * -------------------------------------
+ * The round trip through an image is checked on programs made up from
+ * a fixed seed.  Their expressions may assign, even to a constant,
+ * except in IF, which reads = as its comparison.  They may loop
+ * forever, so they run in slices and are stopped after a fixed number
+ * of them, which stops both runs at the same statement.
+ */
+
+static unsigned randomState = 12345;
+
+static int randomInt(int n) {
+   randomState = randomState * 1103515245u + 12345u;
+   return (randomState >> 16) % n;
+}
+
+static string randomExp(int depth, bool assign = true) {
+   static const char *const VARS[] = { "a", "b", "c", "d" };
+   static const char *const OPS[] = { "+", "-", "*", "/" };
+   int choice = randomInt(depth > 2 ? 2 : assign ? 5 : 4);
+   if (choice == 0) return to_string(randomInt(20));
+   if (choice == 1) return VARS[randomInt(4)];
+   if (choice == 4) {
+      string target = randomInt(4) == 0 ? to_string(randomInt(20)) : VARS[randomInt(4)];
+      return "(" + target + " = " + randomExp(depth + 1) + ")";
+   }
+   string exp = randomExp(depth + 1, assign) + " " + OPS[randomInt(4)] + " " + randomExp(depth + 1, assign);
+   return choice == 2 ? "(" + exp + ")" : exp;
+}
+
+static string randomProgram() {
+   ostringstream s;
+   s << "1 LET a = 1\n2 LET b = 2\n3 LET c = 3\n4 LET d = 4\n";
+   int count = 3 + randomInt(15);
+   for (int i = 1; i <= count; i++) {
+      s << i * 10 << " ";
+      int target = 10 * (1 + randomInt(count + 1));
+      switch (randomInt(7)) {
+         case 0: s << "LET " << "abcd"[randomInt(4)] << " = " << randomExp(0); break;
+         case 1: s << "PRINT " << randomExp(0); break;
+         case 2: s << "IF " << randomExp(1, false) << " " << "<>="[randomInt(3)] << " "
+                   << randomExp(1, false) << " THEN " << target; break;
+         case 3: s << "GOTO " << target; break;
+         case 4: s << "REM note " << randomInt(100); break;
+         case 5: s << "END"; break;
+         default: s << "LET " << "abcd"[randomInt(4)] << " = " << "abcd"[randomInt(4)] << " + 1";
+      }
+      s << "\n";
+   }
+   return s.str();
+}
+
+static string listAndRun(Session & session, OutputSink & sink, string & out) {
+   session.processLine("LIST");
+   session.processLine("RUN");
+   for (int i = 0; i < 200 && session.isRunnable(); i++) session.resume();
+   sink.flush();
+   return out;
+}
+
+static string imageRoundTrip(const string & program, const string & image, bool compact) {
+   string outA, outB;
+   LineReader inA((string())), inB((string()));
+   OutputSink sinkA(outA), sinkB(outB);
+   Session a(inA, sinkA), b(inB, sinkB);
+   a.getProgram().setCompact(compact);
+   b.getProgram().setCompact(compact);
+   a.setSlice(50);
+   b.setSlice(50);
+   istringstream lines(program);
+   string line;
+   while (getline(lines, line)) a.processLine(line);
+   a.processLine("SAVE " + image);
+   b.processLine("LOAD " + image);
+   string before = listAndRun(a, sinkA, outA);
+   string after = listAndRun(b, sinkB, outB);
+   return before == after ? "" : before + "--- after LOAD ---\n" + after;
+}
+
+static void testImages(const string & directory) {
+   string image = directory + "/round.img";
+   string program = "10 REM start\n20 LET a = 6\n30 INPUT b\n40 IF a * b > 20 THEN 60\n"
+                    "50 PRINT 0\n60 PRINT a * b - (a / 4)\n70 GOTO 90\n80 PRINT 99\n90 END\n";
+   string expected = runScript(program + "LIST\nRUN\n5\n");
+   checkEqual(runScript(program + "SAVE " + image + "\n"), "", "SAVE");
+   checkEqual(runScript("LOAD " + image + "\nLIST\nRUN\n5\n"), expected, "LOAD after SAVE");
+   string assignments = "10 LET a = (b = 3) + 1\n20 PRINT a * b\n30 PRINT 1 = 2\n40 PRINT 5\n";
+   checkEqual(imageRoundTrip(assignments, image, false), "", "image round trip of assignments");
+   int differences = 0;
+   for (int i = 0; i < 300; i++) {
+      string program = randomProgram();
+      string diff = imageRoundTrip(program, image, i % 3 == 0);
+      if (diff != "" && differences++ == 0) {
+         check(false, "image round trip of\n" + program + diff);
+      }
+   }
+   check(differences == 0, "random programs survive SAVE and LOAD");
+}
+
+static void testConfinedImages(const string & directory) {
+   string out;
+   {
+      LineReader in((string()));
+      OutputSink sink(out);
+      Session session(in, sink);
+      session.setImageDirectory(directory);
+      session.processLine("10 PRINT 8");
+      session.processLine("SAVE ../escape.img");
+      session.processLine("SAVE .hidden");
+      session.processLine("LOAD /etc/passwd");
+      session.processLine("SAVE kept.img");
+      session.processLine("10 PRINT 9");
+      session.processLine("LOAD kept.img");
+      session.processLine("RUN");
+      session.setImageDirectory("");
+      session.processLine("SAVE kept.img");
+   }
+   checkEqual(out, "INVALID FILE NAME\nINVALID FILE NAME\nINVALID FILE NAME\n8\n"
+                   "SAVE AND LOAD ARE DISABLED\n", "SAVE and LOAD in a directory");
+   check(access((directory + "/kept.img").c_str(), F_OK) == 0, "SAVE writes into the directory");
+}
+
+/*
+ * Function: testCodeCache
+ * -----------------------
+ * A cache over its limit deletes its own images, oldest first, and its
+ * temporary files, but nothing else in its directory.
+ */
+
+static void testCodeCache(const string & directory) {
+   string cacheDirectory = directory + "/cache";
+   CodeCache cache(cacheDirectory, 1);
+   string precious = cacheDirectory + "/precious.txt";
+   string stale = cacheDirectory + "/0123456789abcdef0123456789abcdef.img.1.2.tmp";
+   string unrelated = cacheDirectory + "/notes.img.1.2.tmp";
+   const string files[] = { precious, stale, unrelated };
+   for (int i = 0; i < 3; i++) {
+      FILE *file = fopen(files[i].c_str(), "w");
+      if (file != nullptr) {
+         fputs("keep me\n", file);
+         fclose(file);
+      }
+   }
+   for (int i = 0; i < 3; i++) {
+      string text = "10 PRINT " + to_string(i) + "\n";
+      Program program;
+      vector<string> errors;
+      program.loadSource(text.c_str(), text.size(), errors);
+      check(!cache.load(program, text.c_str(), text.size()), "a new program misses");
+      cache.store(program, text.c_str(), text.size());
+      check(cache.load(program, text.c_str(), text.size()), "a stored program hits");
+   }
+   check(cache.getEvictions() == 3, "the cache deletes its own files");
+   check(access(precious.c_str(), F_OK) == 0 && access(unrelated.c_str(), F_OK) == 0,
+         "the cache keeps files it did not write");
+   check(access(stale.c_str(), F_OK) != 0, "the cache deletes its temporary files");
+}
+
+/*
+ * Function: testConcurrentSaves
+ * -----------------------------
+ * Sessions that save to the same image at the same time must leave one
+ * of their programs in it, whole.
+ */
+
+static void testConcurrentSaves(const string & directory) {
+   const int THREADS = 8;
+   string image = directory + "/shared.img";
+   vector<thread> pool;
+   vector<string> errors(THREADS);
+   for (int t = 0; t < THREADS; t++) {
+      pool.push_back(thread([&errors, image, t]() {
+         ostringstream program;
+         for (int line = 1; line <= 500; line++) program << line << " PRINT " << t << "\n";
+         for (int i = 0; i < 10; i++) errors[t] += runScript(program.str() + "SAVE " + image + "\n");
+      }));
+   }
+   for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+   for (int t = 0; t < THREADS; t++) checkEqual(errors[t], "", "concurrent SAVE");
+   istringstream out(runScript("LOAD " + image + "\nRUN\n"));
+   set<string> values;
+   int count = 0;
+   string line;
+   while (getline(out, line)) {
+      values.insert(line);
+      count++;
+   }
+   check(count == 500 && values.size() == 1, "an image saved concurrently is whole");
+}
+
+int main() {
+   char pattern[] = "/tmp/session_test.XXXXXX";
+   if (mkdtemp(pattern) == nullptr) {
+      cout << "FAIL: cannot make a temporary directory" << endl;
+      return 1;
+   }
+   string directory = pattern;
+   testListRanges();
+   testParseErrors();
+   testInputAtEnd();
+   testSuspendedInput();
+   testSlicing();
+   testStatementCounts();
+   testThreads();
+   testSymbolTables();
+   testImages(directory);
+   testConfinedImages(directory);
+   testConcurrentSaves(directory);
+   testCodeCache(directory);
+   if (system(("rm -rf " + directory).c_str()) != 0) cout << "cannot remove " << directory << endl;
+   cout << (failures == 0 ? "session_test: all passed" : "session_test: FAILED") << endl;
+   return failures == 0 ? 0 : 1;
+}